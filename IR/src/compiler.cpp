@@ -36,5 +36,6 @@ int main(int argc, char **argv) {
     Program p = IRParseFile(argv[optind]);
     output << p.toL3() << endl;
     output.close();
+    arena::report("IR");
     return 0;
 }
\ No newline at end of file
@@ -54,7 +54,7 @@ namespace IR {
         return os;
     }
 
-    LabelInst::LabelInst(const string &s) {
+    LabelInst::LabelInst(const symbol::Symbol &s) {
         lb = s;
     }
 
@@ -62,17 +62,17 @@ namespace IR {
         os << lb;
     }
 
-    vector <string> LabelInst::toL3(const map <string, Type> &varMap) {
+    vector <string> LabelInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         l3.push_back(lb);
         return l3;
     }
 
-    BranchInst::BranchInst(const string &s) {
+    BranchInst::BranchInst(const symbol::Symbol &s) {
         lb = s;
     }
 
-    BranchInst::BranchInst(const string &t, const string &lb, const string &rb) {
+    BranchInst::BranchInst(const symbol::Symbol &t, const symbol::Symbol &lb, const symbol::Symbol &rb) {
         this->t = t;
         this->lb = lb;
         this->rb = rb;
@@ -86,7 +86,7 @@ namespace IR {
         }
     }
 
-    vector <string> BranchInst::toL3(const map <string, Type> &varMap) {
+    vector <string> BranchInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         if (t.empty()) {
             l3.push_back("br " + lb);
@@ -96,7 +96,7 @@ namespace IR {
         return l3;
     }
 
-    ReturnInst::ReturnInst(const string &s) {
+    ReturnInst::ReturnInst(const symbol::Symbol &s) {
         t = s;
     }
 
@@ -107,7 +107,7 @@ namespace IR {
         }
     }
 
-    vector <string> ReturnInst::toL3(const map <string, Type> &varMap) {
+    vector <string> ReturnInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         if (t.empty()) {
             l3.push_back("return");
@@ -117,7 +117,7 @@ namespace IR {
         return l3;
     }
 
-    TypeInst::TypeInst(const string &t, const string &v) {
+    TypeInst::TypeInst(const symbol::Symbol &t, const symbol::Symbol &v) {
         type = Type(t);
         var = v;
     }
@@ -126,23 +126,23 @@ namespace IR {
         os << type.toString() << " " << var;
     }
 
-    vector <string> TypeInst::toL3(const map <string, Type> &varMap) {
+    vector <string> TypeInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         return l3;
     }
 
-    AssignInst::AssignInst(const string &v, const string &s) {
+    AssignInst::AssignInst(const symbol::Symbol &v, const symbol::Symbol &s) {
         var = v;
         this->s = s;
     }
 
-    AssignInst::AssignInst(const string &v, const vector <string> &ts, const string &s) {
+    AssignInst::AssignInst(const symbol::Symbol &v, const vector<symbol::Symbol> &ts, const symbol::Symbol &s) {
         var = v;
         this->s = s;
         varIndex = ts;
     }
 
-    AssignInst::AssignInst(const string &lv, const string &rv, const vector <string> &ts) {
+    AssignInst::AssignInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const vector<symbol::Symbol> &ts) {
         var = lv;
         s = rv;
         sIndex = ts;
@@ -165,12 +165,12 @@ namespace IR {
         }
     }
 
-    vector <string> AssignInst::toL3(const map <string, Type> &varMap) {
+    vector <string> AssignInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         string addr = "_addr_asn_inst_", dim = "_dim_asn_inst_", ofst = "_ofst_asn_inst_", fct = "_fct_asn_inst_";
         if (!varIndex.empty() || !sIndex.empty()) {
-            vector<string> indexes = varIndex.empty() ? sIndex : varIndex;
-            string array = varIndex.empty() ? s : var;
+            const vector<symbol::Symbol> &indexes = varIndex.empty() ? sIndex : varIndex;
+            const symbol::Symbol &array = varIndex.empty() ? s : var;
             assert(varMap.count(array) > 0);
             if (varMap.at(array).type == TUPLE) {
                 assert(indexes.size() == 1);
@@ -209,7 +209,7 @@ namespace IR {
         return l3;
     }
 
-    AssignOpInst::AssignOpInst(const string &var, const string &lt, const string &rt, const string &op) {
+    AssignOpInst::AssignOpInst(const symbol::Symbol &var, const symbol::Symbol &lt, const symbol::Symbol &rt, const symbol::Symbol &op) {
         this->var = var;
         this->lt = lt;
         this->rt = rt;
@@ -220,13 +220,13 @@ namespace IR {
         os << var << " <- " << lt << " " << opToString(op) << " " << rt;
     }
 
-    vector <string> AssignOpInst::toL3(const map <string, Type> &varMap) {
+    vector <string> AssignOpInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         l3.push_back(strip(var) + " <- " + strip(lt) + " " + opToString(op) + " " + strip(rt));
         return l3;
     }
 
-    AssignLengthInst::AssignLengthInst(const string &lv, const string &rv, const string &t) {
+    AssignLengthInst::AssignLengthInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const symbol::Symbol &t) {
         this->lv = lv;
         this->rv = rv;
         this->t = t;
@@ -236,7 +236,7 @@ namespace IR {
         os << lv << " <- length " << rv << " " << t;
     }
 
-    vector <string> AssignLengthInst::toL3(const map <string, Type> &varMap) {
+    vector <string> AssignLengthInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         string addr = "_addr_len_inst_";
         if (isVar(t)) {
@@ -250,12 +250,12 @@ namespace IR {
         return l3;
     }
 
-    AssignCallInst::AssignCallInst(const string &c, const vector <string> &as) {
+    AssignCallInst::AssignCallInst(const symbol::Symbol &c, const vector<symbol::Symbol> &as) {
         callee = c;
         args = as;
     }
 
-    AssignCallInst::AssignCallInst(const string &v, const string &c, const vector <string> &as) {
+    AssignCallInst::AssignCallInst(const symbol::Symbol &v, const symbol::Symbol &c, const vector<symbol::Symbol> &as) {
         var = v;
         callee = c;
         args = as;
@@ -276,7 +276,7 @@ namespace IR {
         os << ")";
     }
 
-    vector <string> AssignCallInst::toL3(const map <string, Type> &varMap) {
+    vector <string> AssignCallInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         stringstream ss;
         if (!var.empty()) {
@@ -295,7 +295,7 @@ namespace IR {
         return l3;
     }
 
-    NewArrayInst::NewArrayInst(const string &v, const vector <string> as) {
+    NewArrayInst::NewArrayInst(const symbol::Symbol &v, const vector<symbol::Symbol> &as) {
         var = v;
         args = as;
     }
@@ -311,7 +311,7 @@ namespace IR {
         os << ")";
     }
 
-    vector <string> NewArrayInst::toL3(const map <string, Type> &varMap) {
+    vector <string> NewArrayInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         string cnt = "_cnt_nry_inst_", dim = "_dim_nry_inst_", addr = "_addr_nry_inst_";
         l3.push_back(cnt + " <- 1");
@@ -336,7 +336,7 @@ namespace IR {
         return l3;
     }
 
-    NewTupleInst::NewTupleInst(const string &v, const string &t) {
+    NewTupleInst::NewTupleInst(const symbol::Symbol &v, const symbol::Symbol &t) {
         var = v;
         this->t = t;
     }
@@ -345,7 +345,7 @@ namespace IR {
         os << var << " <- new Tuple(" << t << ")";
     }
 
-    vector <string> NewTupleInst::toL3(const map <string, Type> &varMap) {
+    vector <string> NewTupleInst::toL3(const symbol::Table<Type> &varMap) {
         vector <string> l3;
         l3.push_back(strip(var) + " <- call allocate(" + strip(t) + ", 1)");
         return l3;
@@ -355,23 +355,8 @@ namespace IR {
         instructions = insts;
     }
 
-    BasicBlock::~BasicBlock() {
-        for (auto const &inst : instructions) {
-            delete inst;
-        }
-    }
-
-    Function::~Function() {
-        for (auto const &arg : arguments) {
-            delete arg;
-        }
-        for (auto const &b : basicBlocks) {
-            delete b;
-        }
-    }
-
-    string Function::toL3() {
-        map <string, Type> varMap;
+    string Function::toL3(symbol::Table<Type> &varMap) {
+        varMap.clear();
         stringstream ss;
         ss << "define " << name << " (";
         for (int i = 0; i < arguments.size(); i++) {
@@ -398,16 +383,14 @@ namespace IR {
         return ss.str();
     }
 
-    Program::~Program() {
-        for (auto const &f : functions) {
-            delete f;
-        }
-    }
-
     string Program::toL3() {
+        /*
+         * Types of the variables of the function being lowered, by symbol id.
+         * */
+        symbol::Table<Type> varMap;
         stringstream ss;
         for (auto const &f : functions) {
-            ss << f->toL3() << endl;
+            ss << f->toL3(varMap) << endl;
         }
         return ss.str();
     }
@@ -4,6 +4,8 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <arena.h>
+#include <symbol.h>
 
 
 using namespace std;
@@ -71,176 +73,170 @@ namespace IR {
         string toString();
     };
 
-    struct Instruction {
+    struct Instruction : arena::Node {
         virtual ~Instruction() {};
 
         virtual void print(ostream &os) = 0;
 
-        virtual vector <string> toL3(const map<string, Type> &varMap) = 0;
+        virtual vector <string> toL3(const symbol::Table<Type> &varMap) = 0;
     };
 
     ostream &operator<<(ostream &os, Instruction &inst);
 
     struct LabelInst : public Instruction {
-        string lb;
+        symbol::Symbol lb;
 
-        LabelInst(const string &s);
+        LabelInst(const symbol::Symbol &s);
 
         ~LabelInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct BranchInst : public Instruction {
-        string t, lb, rb;
+        symbol::Symbol t, lb, rb;
 
-        BranchInst(const string &s);
+        BranchInst(const symbol::Symbol &s);
 
-        BranchInst(const string &t, const string &lb, const string &rb);
+        BranchInst(const symbol::Symbol &t, const symbol::Symbol &lb, const symbol::Symbol &rb);
 
         ~BranchInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct ReturnInst : public Instruction {
-        string t;
+        symbol::Symbol t;
 
         ReturnInst() {};
 
-        ReturnInst(const string &s);
+        ReturnInst(const symbol::Symbol &s);
 
         ~ReturnInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct TypeInst : public Instruction {
         Type type;
-        string var;
+        symbol::Symbol var;
 
-        TypeInst(const string &t, const string &s);
+        TypeInst(const symbol::Symbol &t, const symbol::Symbol &s);
 
         ~TypeInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct AssignInst : public Instruction {
-        string var, s;
-        vector <string> varIndex, sIndex;
+        symbol::Symbol var, s;
+        vector<symbol::Symbol> varIndex, sIndex;
 
-        AssignInst(const string &v, const string &s);
+        AssignInst(const symbol::Symbol &v, const symbol::Symbol &s);
 
-        AssignInst(const string &lv, const string &rv, const vector <string> &ts);
+        AssignInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const vector<symbol::Symbol> &ts);
 
-        AssignInst(const string &v, const vector <string> &ts, const string &s);
+        AssignInst(const symbol::Symbol &v, const vector<symbol::Symbol> &ts, const symbol::Symbol &s);
 
         ~AssignInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct AssignOpInst : public Instruction {
-        string var, lt, rt;
+        symbol::Symbol var, lt, rt;
         OP op;
 
-        AssignOpInst(const string &var, const string &lt, const string &rt, const string &op);
+        AssignOpInst(const symbol::Symbol &var, const symbol::Symbol &lt, const symbol::Symbol &rt, const symbol::Symbol &op);
 
         ~AssignOpInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct AssignLengthInst : public Instruction {
-        string lv, rv, t;
+        symbol::Symbol lv, rv, t;
 
-        AssignLengthInst(const string &lv, const string &rv, const string &t);
+        AssignLengthInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const symbol::Symbol &t);
 
         ~AssignLengthInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct AssignCallInst : public Instruction {
-        string var, callee;
-        vector <string> args;
+        symbol::Symbol var, callee;
+        vector<symbol::Symbol> args;
 
-        AssignCallInst(const string &c, const vector <string> &as);
+        AssignCallInst(const symbol::Symbol &c, const vector<symbol::Symbol> &as);
 
-        AssignCallInst(const string &v, const string &c, const vector <string> &as);
+        AssignCallInst(const symbol::Symbol &v, const symbol::Symbol &c, const vector<symbol::Symbol> &as);
 
         ~AssignCallInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct NewArrayInst : public Instruction {
-        string var;
-        vector <string> args;
+        symbol::Symbol var;
+        vector<symbol::Symbol> args;
 
-        NewArrayInst(const string &v, const vector <string> as);
+        NewArrayInst(const symbol::Symbol &v, const vector<symbol::Symbol> &as);
 
         ~NewArrayInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
     struct NewTupleInst : public Instruction {
-        string var, t;
+        symbol::Symbol var, t;
 
-        NewTupleInst(const string &v, const string &t);
+        NewTupleInst(const symbol::Symbol &v, const symbol::Symbol &t);
 
         ~NewTupleInst() {};
 
         void print(ostream &os);
 
-        vector <string> toL3(const map<string, Type> &varMap);
+        vector <string> toL3(const symbol::Table<Type> &varMap);
     };
 
-    struct BasicBlock {
+    struct BasicBlock : arena::Node {
         vector<Instruction *> instructions;
 
         BasicBlock(vector<Instruction *> insts);
-
-        ~BasicBlock();
     };
 
-    struct Function {
-        string name;
+    struct Function : arena::Node {
+        symbol::Symbol name;
         Type returnType;
         vector<TypeInst *> arguments;
         vector<BasicBlock *> basicBlocks;
 
-        ~Function();
-
-        string toL3();
+        string toL3(symbol::Table<Type> &varMap);
     };
 
     struct Program {
-        string name;
+        symbol::Symbol name;
         vector<Function *> functions;
 
-        ~Program();
-
         string toL3();
     };
 }
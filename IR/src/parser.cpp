@@ -95,7 +95,8 @@ namespace IR {
     struct p : seq<plus<seq<seps, f>>, seps> {};
 
 
-    vector<std::string> operators, operands;
+    vector<std::string> operators;
+    vector<symbol::Symbol> operands;
     vector<Instruction *> instructions;
     inline void clearCache() {
         operators.clear();
@@ -108,42 +109,42 @@ namespace IR {
     template<>
     struct action<T> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<type> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<callee> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<s> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<t> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<u> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
@@ -157,14 +158,14 @@ namespace IR {
     template<>
     struct action<label> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<var> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
@@ -208,7 +209,7 @@ namespace IR {
         static void apply(const input &in, Program &p) {
             assert(operands.empty());
             assert(operators.empty());
-            instructions.push_back(new LabelInst(in.string()));
+            instructions.push_back(new LabelInst(symbol::Symbol(in.begin(), in.size())));
             clearCache();
 #ifdef DEBUG
             cout << ++n << "\t" << *instructions.back() << endl;
@@ -286,7 +287,7 @@ namespace IR {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 8);
             assert(operators.empty());
-            std::string lv = operands[5], rv = operands[6];
+            symbol::Symbol lv = operands[5], rv = operands[6];
             operands.erase(operands.begin(), operands.begin() + 7);
             instructions.push_back(new AssignInst(lv, rv, operands));
             clearCache();
@@ -298,7 +299,7 @@ namespace IR {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 3);
             assert(operators.empty());
-            std::string var = operands.front(), s = operands.back();
+            symbol::Symbol var = operands.front(), s = operands.back();
             operands.erase(operands.begin());
             operands.pop_back();
             instructions.push_back(new AssignInst(var, operands, s));
@@ -321,7 +322,7 @@ namespace IR {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 1);
             assert(operators.empty());
-            std::string callee = operands[0];
+            symbol::Symbol callee = operands[0];
             operands.erase(operands.begin());
             instructions.push_back(new AssignCallInst(callee, operands));
             clearCache();
@@ -333,7 +334,7 @@ namespace IR {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 5);
             assert(operators.empty());
-            std::string var = operands[3], callee = operands[4];
+            symbol::Symbol var = operands[3], callee = operands[4];
             operands.erase(operands.begin(), operands.begin() + 5);
             instructions.push_back(new AssignCallInst(var, callee, operands));
             clearCache();
@@ -345,7 +346,7 @@ namespace IR {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 3);
             assert(operators.empty());
-            std::string var = operands[1];
+            symbol::Symbol var = operands[1];
             operands.erase(operands.begin(), operands.begin() + 2);
             instructions.push_back(new NewArrayInst(var, operands));
             clearCache();
@@ -1,5 +1,11 @@
 #!/bin/bash
 
+# With -x the tests run inside the compiler instead of through L1c and a.out
+jit=0 ;
+if test "$1" == "-x" ; then
+  jit=1 ;
+fi
+
 passed=0 ;
 failed=0 ;
 cd tests ; 
@@ -14,8 +20,12 @@ for i in *.L1 ; do
   # Generate the binary
   pushd ./ ;
   cd ../ ;
-  ./L1c tests/${i} ;
-  ./a.out &> tests/${i}.out.tmp ;
+  if test $jit -eq 1 ; then
+    ./bin/L1 -x tests/${i} &> tests/${i}.out.tmp ;
+  else
+    ./L1c tests/${i} ;
+    ./a.out &> tests/${i}.out.tmp ;
+  fi
   cmp tests/${i}.out.tmp tests/${i}.out ;
   if ! test $? -eq 0 ; then
     echo "  Failed" ;
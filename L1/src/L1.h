@@ -1,25 +1,68 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <arena.h>
+#include <symbol.h>
 
 namespace L1 {
 
     enum Operator_Type {
         EMPTY, MOVQ, ADDQ, SUBQ, IMULQ, ANDQ, SALQ, SARQ,
         CJUMP, LABEL, GOTO, RETURN, CALL, PRINT, ALLOCATE,
-        ARRAY_ERROR, CISC, MEM, INC, DEC, LQ, EQ, LEQ
+        ARRAY_ERROR, CISC, MEM, INC, DEC, LQ, EQ, LEQ,
+        MEM_INDEX
     };
 
     struct L1_item {
         std::string labelName;
     };
 
-    struct Instruction {
-        std::vector<L1::Operator_Type> operators;
-        std::vector<std::string> operands;
+    enum Operand_Kind : uint8_t {
+        NO_OPERAND, REGISTER, NUMBER, LABEL_NAME
     };
 
-    struct Function {
+    /*
+     * A register is its index in register_names, a label the id of its interned name, so
+     * labels compare equal across functions. Numbers only have a value.
+     * */
+    struct Operand {
+        Operand_Kind kind;
+        int32_t id;
+        int64_t value;
+    };
+
+    inline bool operator==(const Operand &a, const Operand &b) {
+        return a.kind == b.kind && a.id == b.id && a.value == b.value;
+    }
+
+    inline bool operator!=(const Operand &a, const Operand &b) {
+        return !(a == b);
+    }
+
+    const int32_t register_count = 16;
+
+    extern const char *const register_names[register_count];
+
+    int32_t register_id(const std::string &name);
+
+    inline const std::string &label_name(const Operand &o) {
+        return symbol::interner().name(o.id);
+    }
+
+    /*
+     * The parser can leave operands of alternatives that did not match behind the ones an
+     * instruction uses, so operand_count is an upper bound.
+     * */
+    struct Instruction : arena::Node {
+        Operator_Type operators[3];
+        Operand operands[5];
+        uint8_t operator_count = 0;
+        uint8_t operand_count = 0;
+    };
+
+    struct Function : arena::Node {
         std::string name;
         int64_t arguments;
         int64_t locals;
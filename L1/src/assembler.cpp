@@ -0,0 +1,630 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+
+#include "assembler.h"
+
+using namespace std;
+
+namespace L1 {
+    enum Operand_Kind {
+        REGISTER, IMMEDIATE, LABEL_ADDRESS, MEMORY, INDEXED
+    };
+
+    struct Operand {
+        Operand_Kind kind;
+        int reg = 0;
+        int size = 8;
+        int64_t value = 0;
+        string label;
+        int base = 0, index = 0, scale = 1;
+    };
+
+    enum Item_Kind {
+        CODE, LABEL_DEF, JUMP, LOCAL_CALL
+    };
+
+    /*
+     * A run of encoded bytes, a label, or a jump whose size depends on the distance to its
+     * target.
+     * */
+    struct Item {
+        Item_Kind kind;
+        vector<uint8_t> bytes;
+        string target;
+        int cc = -1;
+        bool near = false;
+        int64_t offset = 0;
+        int64_t label_offset = -1;
+        string label_address;
+        string external;
+    };
+
+    const map<string, pair<int, int>> register_names = {
+            {"rax",  {0,  8}}, {"rcx",  {1,  8}}, {"rdx",  {2,  8}}, {"rbx",  {3,  8}},
+            {"rsp",  {4,  8}}, {"rbp",  {5,  8}}, {"rsi",  {6,  8}}, {"rdi",  {7,  8}},
+            {"r8",   {8,  8}}, {"r9",   {9,  8}}, {"r10",  {10, 8}}, {"r11",  {11, 8}},
+            {"r12",  {12, 8}}, {"r13",  {13, 8}}, {"r14",  {14, 8}}, {"r15",  {15, 8}},
+            {"eax",  {0,  4}}, {"ecx",  {1,  4}}, {"edx",  {2,  4}}, {"ebx",  {3,  4}},
+            {"esp",  {4,  4}}, {"ebp",  {5,  4}}, {"esi",  {6,  4}}, {"edi",  {7,  4}},
+            {"r8d",  {8,  4}}, {"r9d",  {9,  4}}, {"r10d", {10, 4}}, {"r11d", {11, 4}},
+            {"r12d", {12, 4}}, {"r13d", {13, 4}}, {"r14d", {14, 4}}, {"r15d", {15, 4}},
+            {"al",   {0,  1}}, {"cl",   {1,  1}}, {"dl",   {2,  1}}, {"bl",   {3,  1}},
+            {"spl",  {4,  1}}, {"bpl",  {5,  1}}, {"sil",  {6,  1}}, {"dil",  {7,  1}},
+            {"r8b",  {8,  1}}, {"r9b",  {9,  1}}, {"r10b", {10, 1}}, {"r11b", {11, 1}},
+            {"r12b", {12, 1}}, {"r13b", {13, 1}}, {"r14b", {14, 1}}, {"r15b", {15, 1}}
+    };
+
+    const map<string, int> condition_codes = {
+            {"o", 0}, {"no", 1}, {"b", 2}, {"ae", 3}, {"e", 4}, {"ne", 5}, {"be", 6}, {"a", 7},
+            {"s", 8}, {"ns", 9}, {"p", 10}, {"np", 11}, {"l", 12}, {"ge", 13}, {"le", 14}, {"g", 15}
+    };
+
+    /*
+     * Group 1 arithmetic: the opcode of (op r/m, r) is 8 * group + 1, the one of (op r, r/m)
+     * is 8 * group + 3, and group is the /digit of the immediate forms.
+     * */
+    const map<string, int> arith_groups = {
+            {"addq", 0}, {"andq", 4}, {"subq", 5}, {"cmpq", 7}
+    };
+
+    inline bool fits_int8(int64_t v) {
+        return v >= -128 && v <= 127;
+    }
+
+    inline bool fits_int32(int64_t v) {
+        return v >= INT32_MIN && v <= INT32_MAX;
+    }
+
+    void put(vector<uint8_t> &bytes, uint64_t value, int size) {
+        for (int i = 0; i < size; i++) {
+            bytes.push_back((value >> (8 * i)) & 0xff);
+        }
+    }
+
+    bool parse_register(const string &s, Operand &o) {
+        if (s.size() < 2 || s[0] != '%' || register_names.count(s.substr(1)) == 0) {
+            return false;
+        }
+        o.kind = REGISTER;
+        o.reg = register_names.at(s.substr(1)).first;
+        o.size = register_names.at(s.substr(1)).second;
+        return true;
+    }
+
+    bool parse_operand(const string &s, Operand &o) {
+        if (s.empty()) {
+            return false;
+        }
+        if (s[0] == '%') {
+            return parse_register(s, o);
+        }
+        if (s[0] == '$') {
+            if (s.size() > 1 && s[1] == '_') {
+                o.kind = LABEL_ADDRESS;
+                o.label = s.substr(1);
+            } else {
+                o.kind = IMMEDIATE;
+                o.value = stoll(s.substr(1));
+            }
+            return true;
+        }
+        size_t open = s.find('(');
+        if (open == string::npos || s.back() != ')') {
+            return false;
+        }
+        string inside = s.substr(open + 1, s.size() - open - 2);
+        o.value = open > 0 ? stoll(s.substr(0, open)) : 0;
+        Operand r;
+        size_t comma = inside.find(',');
+        if (comma == string::npos) {
+            if (!parse_register(inside, r)) {
+                return false;
+            }
+            o.kind = MEMORY;
+            o.base = r.reg;
+            return true;
+        }
+        /*
+         * (%base, %index, scale)
+         * */
+        vector<string> parts;
+        stringstream ss(inside);
+        string part;
+        while (getline(ss, part, ',')) {
+            size_t first = part.find_first_not_of(' ');
+            parts.push_back(first == string::npos ? "" : part.substr(first));
+        }
+        Operand b, i;
+        if (parts.size() != 3 || !parse_register(parts[0], b) || !parse_register(parts[1], i)) {
+            return false;
+        }
+        o.kind = INDEXED;
+        o.base = b.reg;
+        o.index = i.reg;
+        o.scale = stoi(parts[2]);
+        return o.scale == 1 || o.scale == 2 || o.scale == 4 || o.scale == 8;
+    }
+
+    vector<string> split_operands(const string &s) {
+        vector<string> operands;
+        string current;
+        int depth = 0;
+        for (char c : s) {
+            if (c == '(') {
+                depth++;
+            } else if (c == ')') {
+                depth--;
+            }
+            if (c == ',' && depth == 0) {
+                operands.push_back(current);
+                current.clear();
+            } else if (c != ' ' || depth > 0) {
+                current += c;
+            }
+        }
+        if (!current.empty()) {
+            operands.push_back(current);
+        }
+        return operands;
+    }
+
+    void encode(Item &item, bool wide, const vector<uint8_t> &opcode, int reg, const Operand &rm,
+                bool byte_register = false) {
+        /*
+         * REX prefix, opcode, ModRM, SIB and displacement of an instruction with one r/m
+         * operand. reg is the register or the /digit in the ModRM reg field.
+         * */
+        vector<uint8_t> &bytes = item.bytes;
+        int rex = 0x40 | (wide ? 8 : 0) | (reg >= 8 ? 4 : 0);
+        if (rm.kind == REGISTER) {
+            rex |= rm.reg >= 8 ? 1 : 0;
+        } else if (rm.kind == MEMORY) {
+            rex |= rm.base >= 8 ? 1 : 0;
+        } else {
+            rex |= (rm.index >= 8 ? 2 : 0) | (rm.base >= 8 ? 1 : 0);
+        }
+        /*
+         * spl, bpl, sil and dil only exist with a REX prefix, ah to bh take their place
+         * without one.
+         * */
+        bool needs_rex = byte_register && rm.kind == REGISTER && rm.reg >= 4 && rm.reg < 8;
+        if (rex != 0x40 || needs_rex) {
+            bytes.push_back(rex);
+        }
+        bytes.insert(bytes.end(), opcode.begin(), opcode.end());
+        if (rm.kind == REGISTER) {
+            bytes.push_back(0xc0 | ((reg & 7) << 3) | (rm.reg & 7));
+            return;
+        }
+        int base = rm.base & 7;
+        int64_t disp = rm.value;
+        int mod = disp == 0 && base != 5 ? 0 : (fits_int8(disp) ? 1 : 2);
+        if (rm.kind == MEMORY) {
+            bytes.push_back((mod << 6) | ((reg & 7) << 3) | (base == 4 ? 4 : base));
+            if (base == 4) {
+                bytes.push_back(0x24);
+            }
+        } else {
+            int scale = rm.scale == 1 ? 0 : (rm.scale == 2 ? 1 : (rm.scale == 4 ? 2 : 3));
+            bytes.push_back((mod << 6) | ((reg & 7) << 3) | 4);
+            bytes.push_back((scale << 6) | ((rm.index & 7) << 3) | base);
+        }
+        if (mod == 1) {
+            put(bytes, disp, 1);
+        } else if (mod == 2) {
+            put(bytes, disp, 4);
+        }
+    }
+
+    void immediate(Item &item, const Operand &src, int size) {
+        if (src.kind == LABEL_ADDRESS) {
+            item.label_offset = item.bytes.size();
+            item.label_address = src.label;
+        }
+        put(item.bytes, src.kind == LABEL_ADDRESS ? 0 : src.value, size);
+    }
+
+    bool encode_instruction(const string &mnemonic, const vector<Operand> &ops, Item &item) {
+        int n = ops.size();
+        if (mnemonic == "retq" && n == 0) {
+            item.bytes.push_back(0xc3);
+        } else if ((mnemonic == "pushq" || mnemonic == "popq") && n == 1 && ops[0].kind == REGISTER) {
+            if (ops[0].reg >= 8) {
+                item.bytes.push_back(0x41);
+            }
+            item.bytes.push_back((mnemonic == "pushq" ? 0x50 : 0x58) + (ops[0].reg & 7));
+        } else if (mnemonic == "movq" && n == 2) {
+            const Operand &src = ops[0], &dst = ops[1];
+            if (src.kind == REGISTER && dst.kind != IMMEDIATE && dst.kind != LABEL_ADDRESS) {
+                encode(item, true, {0x89}, src.reg, dst);
+            } else if ((src.kind == MEMORY || src.kind == INDEXED) && dst.kind == REGISTER) {
+                encode(item, true, {0x8b}, dst.reg, src);
+            } else if (src.kind == IMMEDIATE && dst.kind == REGISTER && !fits_int32(src.value)) {
+                item.bytes.push_back(dst.reg >= 8 ? 0x49 : 0x48);
+                item.bytes.push_back(0xb8 + (dst.reg & 7));
+                put(item.bytes, src.value, 8);
+            } else if ((src.kind == IMMEDIATE && fits_int32(src.value)) || src.kind == LABEL_ADDRESS) {
+                encode(item, true, {0xc7}, 0, dst);
+                immediate(item, src, 4);
+            } else {
+                return false;
+            }
+        } else if (mnemonic == "movl" && n == 2 && ops[0].kind == IMMEDIATE && ops[1].kind == REGISTER) {
+            if (ops[1].reg >= 8) {
+                item.bytes.push_back(0x41);
+            }
+            item.bytes.push_back(0xb8 + (ops[1].reg & 7));
+            put(item.bytes, ops[0].value, 4);
+        } else if (mnemonic == "xorl" && n == 2 && ops[0].kind == REGISTER && ops[1].kind == REGISTER) {
+            encode(item, false, {0x31}, ops[0].reg, ops[1]);
+        } else if (mnemonic == "movzbq" && n == 2 && ops[0].kind == REGISTER && ops[1].kind == REGISTER) {
+            encode(item, true, {0x0f, 0xb6}, ops[1].reg, ops[0]);
+        } else if (arith_groups.count(mnemonic) > 0 && n == 2) {
+            int group = arith_groups.at(mnemonic);
+            const Operand &src = ops[0], &dst = ops[1];
+            if (src.kind == REGISTER && (dst.kind == REGISTER || dst.kind == MEMORY)) {
+                encode(item, true, {(uint8_t)(8 * group + 1)}, src.reg, dst);
+            } else if (src.kind == MEMORY && dst.kind == REGISTER) {
+                encode(item, true, {(uint8_t)(8 * group + 3)}, dst.reg, src);
+            } else if (src.kind == IMMEDIATE && fits_int8(src.value)) {
+                encode(item, true, {0x83}, group, dst);
+                put(item.bytes, src.value, 1);
+            } else if (src.kind == IMMEDIATE && fits_int32(src.value)) {
+                encode(item, true, {0x81}, group, dst);
+                put(item.bytes, src.value, 4);
+            } else {
+                return false;
+            }
+        } else if (mnemonic == "testq" && n == 2 && ops[0].kind == REGISTER) {
+            encode(item, true, {0x85}, ops[0].reg, ops[1]);
+        } else if (mnemonic == "imulq" && n == 2 && ops[1].kind == REGISTER) {
+            const Operand &src = ops[0], &dst = ops[1];
+            if (src.kind == REGISTER || src.kind == MEMORY) {
+                encode(item, true, {0x0f, 0xaf}, dst.reg, src);
+            } else if (src.kind == IMMEDIATE && fits_int8(src.value)) {
+                encode(item, true, {0x6b}, dst.reg, dst);
+                put(item.bytes, src.value, 1);
+            } else if (src.kind == IMMEDIATE && fits_int32(src.value)) {
+                encode(item, true, {0x69}, dst.reg, dst);
+                put(item.bytes, src.value, 4);
+            } else {
+                return false;
+            }
+        } else if ((mnemonic == "salq" || mnemonic == "sarq") && n == 2) {
+            int digit = mnemonic == "salq" ? 4 : 7;
+            if (ops[0].kind == REGISTER && ops[0].reg == 1 && ops[0].size == 1) {
+                encode(item, true, {0xd3}, digit, ops[1]);
+            } else if (ops[0].kind == IMMEDIATE && ops[0].value == 1) {
+                encode(item, true, {0xd1}, digit, ops[1]);
+            } else if (ops[0].kind == IMMEDIATE) {
+                encode(item, true, {0xc1}, digit, ops[1]);
+                put(item.bytes, ops[0].value, 1);
+            } else {
+                return false;
+            }
+        } else if ((mnemonic == "incq" || mnemonic == "inc" || mnemonic == "decq" || mnemonic == "dec") && n == 1) {
+            encode(item, true, {0xff}, mnemonic[0] == 'i' ? 0 : 1, ops[0]);
+        } else if (mnemonic == "lea" && n == 2 && ops[0].kind == INDEXED && ops[1].kind == REGISTER) {
+            encode(item, true, {0x8d}, ops[1].reg, ops[0]);
+        } else if (mnemonic.compare(0, 3, "set") == 0 && condition_codes.count(mnemonic.substr(3)) > 0 && n == 1 &&
+                   ops[0].kind == REGISTER && ops[0].size == 1) {
+            encode(item, false, {0x0f, (uint8_t)(0x90 + condition_codes.at(mnemonic.substr(3)))}, 0, ops[0], true);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    bool parse_line(const string &line, vector<Item> &items, set<string> &globals) {
+        size_t first = line.find_first_not_of(" \t");
+        if (first == string::npos) {
+            return true;
+        }
+        string text = line.substr(first);
+        if (text == ".text") {
+            return true;
+        }
+        if (text.compare(0, 7, ".globl ") == 0) {
+            globals.insert(text.substr(7));
+            return true;
+        }
+        Item item;
+        if (text.back() == ':') {
+            item.kind = LABEL_DEF;
+            item.target = text.substr(0, text.size() - 1);
+            items.push_back(item);
+            return true;
+        }
+        size_t space = text.find(' ');
+        string mnemonic = text.substr(0, space);
+        string rest = space == string::npos ? "" : text.substr(space + 1);
+
+        if (mnemonic == "jmp" || mnemonic == "call" ||
+                (mnemonic[0] == 'j' && condition_codes.count(mnemonic.substr(1)) > 0)) {
+            if (rest[0] == '*') {
+                Operand target;
+                if (!parse_register(rest.substr(1), target)) {
+                    return false;
+                }
+                item.kind = CODE;
+                encode(item, false, {0xff}, mnemonic == "call" ? 2 : 4, target);
+            } else if (mnemonic == "call") {
+                item.kind = LOCAL_CALL;
+                item.target = rest;
+            } else {
+                item.kind = JUMP;
+                item.target = rest;
+                item.cc = mnemonic == "jmp" ? -1 : condition_codes.at(mnemonic.substr(1));
+            }
+            items.push_back(item);
+            return true;
+        }
+
+        vector<Operand> ops;
+        for (auto const &s : split_operands(rest)) {
+            Operand o;
+            if (!parse_operand(s, o)) {
+                return false;
+            }
+            ops.push_back(o);
+        }
+        item.kind = CODE;
+        if (!encode_instruction(mnemonic, ops, item)) {
+            return false;
+        }
+        items.push_back(item);
+        return true;
+    }
+
+    inline int64_t item_size(const Item &item) {
+        switch (item.kind) {
+            case JUMP:
+                return item.near ? (item.cc == -1 ? 5 : 6) : 2;
+            case LOCAL_CALL:
+                return 5;
+            case LABEL_DEF:
+                return 0;
+            default:
+                return item.bytes.size();
+        }
+    }
+
+    map<string, int64_t> layout(vector<Item> &items) {
+        /*
+         * Jumps start short and only grow, so this settles after a few rounds.
+         * */
+        map<string, int64_t> labels;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            int64_t offset = 0;
+            labels.clear();
+            for (auto &item : items) {
+                item.offset = offset;
+                if (item.kind == LABEL_DEF) {
+                    labels[item.target] = offset;
+                }
+                offset += item_size(item);
+            }
+            for (auto &item : items) {
+                if (item.kind == JUMP && !item.near && labels.count(item.target) > 0 &&
+                        !fits_int8(labels[item.target] - (item.offset + 2))) {
+                    item.near = true;
+                    changed = true;
+                }
+            }
+        }
+        return labels;
+    }
+
+    struct String_Table {
+        vector<uint8_t> bytes = {0};
+
+        uint32_t add(const string &s) {
+            uint32_t offset = bytes.size();
+            bytes.insert(bytes.end(), s.begin(), s.end());
+            bytes.push_back(0);
+            return offset;
+        }
+    };
+
+    void put_symbol(vector<uint8_t> &symtab, uint32_t name, uint8_t info, uint16_t section, uint64_t value) {
+        put(symtab, name, 4);
+        put(symtab, info, 1);
+        put(symtab, 0, 1);
+        put(symtab, section, 2);
+        put(symtab, value, 8);
+        put(symtab, 0, 8);
+    }
+
+    void put_section_header(vector<uint8_t> &out, uint32_t name, uint32_t type, uint64_t flags, uint64_t offset,
+                            uint64_t size, uint32_t link, uint32_t info, uint64_t align, uint64_t entsize) {
+        put(out, name, 4);
+        put(out, type, 4);
+        put(out, flags, 8);
+        put(out, 0, 8);
+        put(out, offset, 8);
+        put(out, size, 8);
+        put(out, link, 4);
+        put(out, info, 4);
+        put(out, align, 8);
+        put(out, entsize, 8);
+    }
+
+    void align(vector<uint8_t> &out, int alignment) {
+        while (out.size() % alignment != 0) {
+            out.push_back(0);
+        }
+    }
+
+    bool encode_assembly(const string &assembly, Machine_Code &code) {
+        vector<Item> items;
+        stringstream lines(assembly);
+        string line;
+        while (getline(lines, line)) {
+            if (!parse_line(line, items, code.globals)) {
+                cerr << "L1 assembler: cannot encode \"" << line << "\"" << endl;
+                return false;
+            }
+        }
+        code.labels = layout(items);
+        map<string, int64_t> &labels = code.labels;
+        vector<uint8_t> &text = code.text;
+
+        for (auto &item : items) {
+            switch (item.kind) {
+                case CODE:
+                    if (item.label_offset != -1) {
+                        if (labels.count(item.label_address) == 0) {
+                            cerr << "L1 assembler: unknown label " << item.label_address << endl;
+                            return false;
+                        }
+                        code.relocations.push_back({(int64_t)text.size() + item.label_offset, "", R_X86_64_32S,
+                                                    labels[item.label_address]});
+                    }
+                    text.insert(text.end(), item.bytes.begin(), item.bytes.end());
+                    break;
+                case JUMP: {
+                    if (labels.count(item.target) == 0) {
+                        cerr << "L1 assembler: unknown label " << item.target << endl;
+                        return false;
+                    }
+                    int64_t end = item.offset + item_size(item);
+                    int64_t displacement = labels[item.target] - end;
+                    if (!item.near) {
+                        text.push_back(item.cc == -1 ? 0xeb : 0x70 + item.cc);
+                        put(text, displacement, 1);
+                    } else {
+                        if (item.cc == -1) {
+                            text.push_back(0xe9);
+                        } else {
+                            text.push_back(0x0f);
+                            text.push_back(0x80 + item.cc);
+                        }
+                        put(text, displacement, 4);
+                    }
+                    break;
+                }
+                case LOCAL_CALL:
+                    text.push_back(0xe8);
+                    if (labels.count(item.target) > 0) {
+                        put(text, labels[item.target] - (item.offset + 5), 4);
+                    } else {
+                        /*
+                         * Calls into the runtime.
+                         * */
+                        code.relocations.push_back({(int64_t)text.size(), item.target, R_X86_64_PLT32, -4});
+                        put(text, 0, 4);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return true;
+    }
+
+    bool write_object(const Machine_Code &code, const string &object_file) {
+        /*
+         * Symbol 1 is the .text section, local labels follow, then the global and the
+         * external symbols.
+         * */
+        String_Table strtab;
+        vector<uint8_t> symtab;
+        put_symbol(symtab, 0, 0, 0, 0);
+        put_symbol(symtab, 0, 3, 1, 0);
+        int symbols = 2;
+        for (auto const &label : code.labels) {
+            if (code.globals.count(label.first) == 0) {
+                put_symbol(symtab, strtab.add(label.first), 0, 1, label.second);
+                symbols++;
+            }
+        }
+        int first_global = symbols;
+        for (auto const &label : code.labels) {
+            if (code.globals.count(label.first) > 0) {
+                put_symbol(symtab, strtab.add(label.first), 1 << 4, 1, label.second);
+                symbols++;
+            }
+        }
+        map<string, int> externals;
+        for (auto const &r : code.relocations) {
+            if (!r.symbol.empty() && externals.count(r.symbol) == 0) {
+                externals[r.symbol] = symbols++;
+                put_symbol(symtab, strtab.add(r.symbol), 1 << 4, 0, 0);
+            }
+        }
+        const vector<uint8_t> &text = code.text;
+
+        vector<uint8_t> rela;
+        for (auto const &r : code.relocations) {
+            put(rela, r.offset, 8);
+            put(rela, ((uint64_t)(r.symbol.empty() ? 1 : externals[r.symbol]) << 32) | r.type, 8);
+            put(rela, r.addend, 8);
+        }
+
+        String_Table shstrtab;
+        uint32_t text_name = shstrtab.add(".text"), rela_name = shstrtab.add(".rela.text"),
+                symtab_name = shstrtab.add(".symtab"), strtab_name = shstrtab.add(".strtab"),
+                shstrtab_name = shstrtab.add(".shstrtab"), stack_name = shstrtab.add(".note.GNU-stack");
+
+        vector<uint8_t> out(64, 0);
+        align(out, 16);
+        uint64_t text_offset = out.size();
+        out.insert(out.end(), text.begin(), text.end());
+        align(out, 8);
+        uint64_t rela_offset = out.size();
+        out.insert(out.end(), rela.begin(), rela.end());
+        align(out, 8);
+        uint64_t symtab_offset = out.size();
+        out.insert(out.end(), symtab.begin(), symtab.end());
+        uint64_t strtab_offset = out.size();
+        out.insert(out.end(), strtab.bytes.begin(), strtab.bytes.end());
+        uint64_t shstrtab_offset = out.size();
+        out.insert(out.end(), shstrtab.bytes.begin(), shstrtab.bytes.end());
+        align(out, 8);
+        uint64_t section_headers = out.size();
+
+        put_section_header(out, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        put_section_header(out, text_name, 1, 0x6, text_offset, text.size(), 0, 0, 16, 0);
+        put_section_header(out, rela_name, 4, 0x40, rela_offset, rela.size(), 3, 1, 8, 24);
+        put_section_header(out, symtab_name, 2, 0, symtab_offset, symtab.size(), 4, first_global, 8, 24);
+        put_section_header(out, strtab_name, 3, 0, strtab_offset, strtab.bytes.size(), 0, 0, 1, 0);
+        put_section_header(out, shstrtab_name, 3, 0, shstrtab_offset, shstrtab.bytes.size(), 0, 0, 1, 0);
+        put_section_header(out, stack_name, 1, 0, shstrtab_offset, 0, 0, 0, 1, 0);
+
+        /*
+         * ELF64 header of a relocatable x86-64 object.
+         * */
+        vector<uint8_t> header = {0x7f, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        put(header, 1, 2);
+        put(header, 62, 2);
+        put(header, 1, 4);
+        put(header, 0, 8);
+        put(header, 0, 8);
+        put(header, section_headers, 8);
+        put(header, 0, 4);
+        put(header, 64, 2);
+        put(header, 0, 2);
+        put(header, 0, 2);
+        put(header, 64, 2);
+        put(header, 7, 2);
+        put(header, 5, 2);
+        copy(header.begin(), header.end(), out.begin());
+
+        ofstream object(object_file, ios::binary);
+        object.write((const char *)out.data(), out.size());
+        return (bool)object;
+    }
+
+    bool assemble(const string &assembly, const string &object_file) {
+        Machine_Code code;
+        return encode_assembly(assembly, code) && write_object(code, object_file);
+    }
+}
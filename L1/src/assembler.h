@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstdint>
+
+namespace L1 {
+    const uint32_t R_X86_64_PLT32 = 4, R_X86_64_32S = 11;
+
+    /*
+     * A field of the text that is only known once the code is placed. An empty symbol
+     * stands for the start of the text itself.
+     * */
+    struct Relocation {
+        int64_t offset;
+        std::string symbol;
+        uint32_t type;
+        int64_t addend;
+    };
+
+    struct Machine_Code {
+        std::vector<uint8_t> text;
+        std::map<std::string, int64_t> labels;
+        std::set<std::string> globals;
+        std::vector<Relocation> relocations;
+    };
+
+    /*
+     * Encodes the x86-64 assembly the L1 compiler emits. Only the instruction forms the
+     * compiler produces are understood. Returns false and reports the offending line on
+     * anything else.
+     * */
+    bool encode_assembly(const std::string &assembly, Machine_Code &code);
+
+    bool write_object(const Machine_Code &code, const std::string &object_file);
+
+    /*
+     * Encodes the assembly into a relocatable ELF object.
+     * */
+    bool assemble(const std::string &assembly, const std::string &object_file);
+}
@@ -12,81 +12,180 @@
 #include <unistd.h>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <cstdlib>
+#include <algorithm>
+#include <sstream>
 
 #include "parser.h"
+#include "peephole.h"
+#include "encoding.h"
+#include "layout.h"
+#include "assembler.h"
+#include "jit.h"
 
 using namespace std;
 
 
-string get_label(string &operand) {
+string get_label(const string &operand) {
     return "_" + operand.substr(1) + ":";
 }
 
-string get_opd(string &operand) {
-    return operand[0] == ':' ? "$_" + operand.substr(1) :
-           (operand[0] == 'r' ? "%" + operand :
-            (operand[0] == '+' ? "$" + operand.substr(1) : "$" + operand));
+string get_register(const L1::Operand &operand) {
+    return string("%") + L1::register_names[operand.id];
 }
 
-string get_mem_opd(string &x, string &m) {
-    return m + "(%" + x + ")";
+string get_opd(const L1::Operand &operand) {
+    return operand.kind == L1::LABEL_NAME ? "$_" + L1::label_name(operand).substr(1) :
+           (operand.kind == L1::REGISTER ? get_register(operand) : "$" + to_string(operand.value));
 }
 
-string get_call_opd(string &operand) {
-    return operand[0] == 'r' ? "*%" + operand : "_" + operand.substr(1);
+string get_mem_opd(const L1::Operand &x, const L1::Operand &m) {
+    return to_string(m.value) + "(" + get_register(x) + ")";
 }
 
-string get_call_shift(string &num_of_args) {
-    int64_t n = stoll(num_of_args);
+string get_index_opd(const L1::Operand &x, const L1::Operand &w, const L1::Operand &e, const L1::Operand &m) {
+    return to_string(m.value) + "(" + get_register(x) + ", " + get_register(w) + ", " + to_string(e.value) + ")";
+}
+
+string get_call_opd(const string &label) {
+    return "_" + label.substr(1);
+}
+
+string get_call_opd(const L1::Operand &operand) {
+    return operand.kind == L1::REGISTER ? "*" + get_register(operand) : get_call_opd(L1::label_name(operand));
+}
+
+string get_call_shift(const L1::Operand &num_of_args) {
+    int64_t n = num_of_args.value;
     n = n <= 6 ? 8 : (n - 5) * 8;
     return "$" + to_string(n);
 }
 
-string get_shift_opd(string &operand) {
-    return operand[0] == 'r' ? "%cl" : "$" + operand;
+string get_shift_opd(const L1::Operand &operand) {
+    return operand.kind == L1::REGISTER ? "%cl" : "$" + to_string(operand.value);
 }
 
-bool eval_inst(string &operand1, string &operand2, L1::Operator_Type &op) {
-    int64_t a = stoll(operand1), b = stoll(operand2);
+bool eval_inst(const L1::Operand &operand1, const L1::Operand &operand2, L1::Operator_Type &op) {
+    int64_t a = operand1.value, b = operand2.value;
     return op == L1::Operator_Type::LQ ? a < b : (op == L1::Operator_Type::LEQ ? a <= b : a == b);
 }
 
-string get_low_reg(string &reg) {
+string get_low_reg(const L1::Operand &operand) {
+    string reg = L1::register_names[operand.id];
     return reg[1] == '1' || reg[1] == '8' || reg[1] == '9' ? "%" + reg + "b" :
            (reg[2] == 'x' ? "%" + string(1, reg[1]) + "l" : "%" + reg.substr(1) + "l");
 }
 
+string get_arith_op(L1::Operator_Type op) {
+    return op == L1::Operator_Type::MOVQ ? "movq" :
+           (op == L1::Operator_Type::ADDQ ? "addq" :
+            (op == L1::Operator_Type::SUBQ ? "subq" :
+             (op == L1::Operator_Type::IMULQ ? "imulq" :
+              (op == L1::Operator_Type::ANDQ ? "andq" :
+               (op == L1::Operator_Type::SALQ ? "salq" :
+                (op == L1::Operator_Type::SARQ ? "sarq" :
+                 (op == L1::Operator_Type::INC ? "incq" : "decq")))))));
+}
+
+bool get_cmp(L1::Instruction *inst, int first, string &left, string &right, L1::Operator_Type &op) {
+    /*
+     * Operands of the comparison starting at operands[first], either side of which can be a
+     * memory operand. Returns true if both sides are constants.
+     * */
+    const L1::Operand *opds = inst->operands;
+    if (inst->operators[1] == L1::Operator_Type::MEM) {
+        op = inst->operators[2];
+        left = get_mem_opd(opds[first], opds[first + 1]);
+        right = get_opd(opds[first + 2]);
+    } else if (inst->operator_count > 2) {
+        op = inst->operators[1];
+        left = get_opd(opds[first]);
+        right = get_mem_opd(opds[first + 1], opds[first + 2]);
+    } else {
+        op = inst->operators[1];
+        if (opds[first].kind != L1::REGISTER && opds[first + 1].kind != L1::REGISTER) {
+            left = eval_inst(opds[first], opds[first + 1], op) ? "1" : "0";
+            return true;
+        }
+        left = get_opd(opds[first]);
+        right = get_opd(opds[first + 1]);
+    }
+    return false;
+}
+
+string emit_cmp(ostream &output, string &left, string &right, L1::Operator_Type op) {
+    /*
+     * Emits the comparison of left with right and returns the condition code that holds when
+     * (left op right) does. cmpq only takes an immediate as its first operand.
+     * */
+    if (left[0] == '$') {
+        output << '\t' << L1::select_cmpq(left, right) << endl;
+        return op == L1::Operator_Type::LQ ? "g" : (op == L1::Operator_Type::LEQ ? "ge" : "e");
+    }
+    output << '\t' << L1::select_cmpq(right, left) << endl;
+    return op == L1::Operator_Type::LQ ? "l" : (op == L1::Operator_Type::LEQ ? "le" : "e");
+}
+
+string invert_condition(const string &cc) {
+    return cc == "l" ? "ge" : (cc == "le" ? "g" : (cc == "g" ? "le" : (cc == "ge" ? "l" : "ne")));
+}
+
 
 int main(int argc, char **argv) {
-    bool verbose;
+    bool verbose = false;
+    bool keep_assembly = false;
+    bool run = false;
 
     /* Check the input.
      */
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " SOURCE [-v]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " SOURCE [-v] [-S] [-x]" << std::endl;
         return 1;
     }
     int32_t opt;
-    while ((opt = getopt(argc, argv, "v")) != -1) {
+    while ((opt = getopt(argc, argv, "vSx")) != -1) {
         switch (opt) {
             case 'v':
                 verbose = true;
                 break;
+            case 'S':
+                keep_assembly = true;
+                break;
+            case 'x':
+                run = true;
+                break;
             default:
-                std::cerr << "Usage: " << argv[0] << "[-v] SOURCE" << std::endl;
+                std::cerr << "Usage: " << argv[0] << "[-v] [-S] [-x] SOURCE" << std::endl;
                 return 1;
         }
     }
 
+    /* Calls either jump after storing their return label, or use call/ret.
+     */
+    bool native_calls = getenv("NATIVE_CALLS") != NULL && string(getenv("NATIVE_CALLS")) == "1";
+
     /* Parse the L1 program.
      */
     L1::Program p = L1::L1_parse_file(argv[optind]);
 
-    /* Generate x86_64 code
+    /* Order the blocks so that most jumps become fallthroughs, then clean up what register
+     * allocation left behind.
      */
+    for (auto f : p.functions) {
+        L1::layout_blocks(f);
+    }
+    map<string, int64_t> fired = L1::peephole(p);
+    if (verbose) {
+        for (auto const &rule : L1::peephole_rules) {
+            cerr << rule.name << ": " << fired[rule.name] << endl;
+        }
+    }
 
-    ofstream output;
-    output.open("prog.S");
+    /* Generate x86_64 code, which is encoded straight into prog.o. -S also keeps the
+     * assembly in prog.S.
+     */
+    ostringstream output;
 
     output << ".text" << endl
            << "\t.globl go" << endl
@@ -111,65 +210,48 @@ int main(int argc, char **argv) {
     for (auto f : p.functions) {
         output << get_label(f->name) << endl;
         if (f->locals > 0) {
-            output << "\tsubq $" << f->locals * 8 << ", %rsp" << endl;
+            output << '\t' << L1::select_arith("subq", "$" + to_string(f->locals * 8), "%rsp") << endl;
         }
-        for (auto inst : f->instructions) {
-            switch (inst->operators.front()) {
+        for (int i = 0; i < f->instructions.size(); i++) {
+            L1::Instruction *inst = f->instructions[i];
+            /*
+             * Label of the instruction emitted right after inst, if any, a jump to it is a
+             * fallthrough.
+             * */
+            string next_label = i + 1 < f->instructions.size() &&
+                                f->instructions[i + 1]->operators[0] == L1::Operator_Type::LABEL
+                                ? get_call_opd(f->instructions[i + 1]->operands[0]) : "";
+            switch (inst->operators[0]) {
                 case L1::Operator_Type::MOVQ:
                     operand = get_opd(inst->operands[0]);
-                    if (inst->operators.size() == 1) {
-                        output << "\tmovq " << get_opd(inst->operands[1]) << ", " << operand;
-                    } else if (inst->operators[1] == L1::Operator_Type::MEM) {
+                    if (inst->operator_count == 1) {
+                        output << '\t' << L1::select_movq(get_opd(inst->operands[1]), operand);
+                    } else if (inst->operator_count == 2 && inst->operators[1] == L1::Operator_Type::MEM) {
                         output << "\tmovq " << get_mem_opd(inst->operands[1], inst->operands[2]) << ", " << operand;
+                    } else if (inst->operators[1] == L1::Operator_Type::MEM_INDEX) {
+                        output << "\tmovq " << get_index_opd(inst->operands[1], inst->operands[2], inst->operands[3],
+                                                              inst->operands[4]) << ", " << operand;
                     } else {
-                        operand2 = inst->operands[1];
-                        operand3 = inst->operands[2];
-                        if (operand2[0] != 'r' && operand3[0] != 'r') {
-                            output << (eval_inst(operand2, operand3, inst->operators[1]) ? "\tmovq $1, "
-                                                                                         : "\tmovq $0, ")
-                                   << operand;
-                        } else if (operand2[0] != 'r') {
-                            output << "\tcmpq " << get_opd(operand2) << ", " << get_opd(operand3) << endl;
-                            label = get_low_reg(inst->operands[0]);
-                            if (inst->operators[1] == L1::Operator_Type::LQ) {
-                                output << "\tsetg ";
-                            } else if (inst->operators[1] == L1::Operator_Type::LEQ) {
-                                output << "\tsetge ";
-                            } else {
-                                output << "\tsete ";
-                            }
-                            output << label << endl << "\tmovzbq " << label << ", " << operand;
+                        L1::Operator_Type cmp;
+                        if (get_cmp(inst, 1, operand2, operand3, cmp)) {
+                            output << '\t' << L1::select_movq("$" + operand2, operand);
                         } else {
-                            output << "\tcmpq " << get_opd(operand3) << ", " << get_opd(operand2) << endl;
                             label = get_low_reg(inst->operands[0]);
-                            if (inst->operators[1] == L1::Operator_Type::LQ) {
-                                output << "\tsetl ";
-                            } else if (inst->operators[1] == L1::Operator_Type::LEQ) {
-                                output << "\tsetle ";
-                            } else {
-                                output << "\tsete ";
-                            }
-                            output << label << endl << "\tmovzbq " << label << ", " << operand;
+                            operand2 = emit_cmp(output, operand2, operand3, cmp);
+                            output << "\tset" << operand2 << ' ' << label << endl
+                                   << "\tmovzbq " << label << ", " << operand;
                         }
                     }
                     break;
                 case L1::Operator_Type::ADDQ:
-                    output << "\taddq "
-                           << (inst->operators.size() == 1 ? get_opd(inst->operands[1]) : get_mem_opd(inst->operands[1],
-                                                                                                      inst->operands[2]))
-                           << ", " << get_opd(inst->operands[0]);
-                    break;
                 case L1::Operator_Type::SUBQ:
-                    output << "\tsubq "
-                           << (inst->operators.size() == 1 ? get_opd(inst->operands[1]) : get_mem_opd(inst->operands[1],
-                                                                                                      inst->operands[2]))
-                           << ", " << get_opd(inst->operands[0]);
-                    break;
                 case L1::Operator_Type::IMULQ:
-                    output << "\timulq " << get_opd(inst->operands[1]) << ", " << get_opd(inst->operands[0]);
-                    break;
                 case L1::Operator_Type::ANDQ:
-                    output << "\tandq " << get_opd(inst->operands[1]) << ", " << get_opd(inst->operands[0]);
+                    output << '\t' << L1::select_arith(get_arith_op(inst->operators[0]),
+                                                        inst->operator_count == 1 ? get_opd(inst->operands[1])
+                                                                                    : get_mem_opd(inst->operands[1],
+                                                                                                  inst->operands[2]),
+                                                        get_opd(inst->operands[0]));
                     break;
                 case L1::Operator_Type::SALQ:
                     output << "\tsalq " << get_shift_opd(inst->operands[1]) << ", " << get_opd(inst->operands[0]);
@@ -177,55 +259,60 @@ int main(int argc, char **argv) {
                 case L1::Operator_Type::SARQ:
                     output << "\tsarq " << get_shift_opd(inst->operands[1]) << ", " << get_opd(inst->operands[0]);
                     break;
-                case L1::Operator_Type::CJUMP:
-                    label = get_call_opd(inst->operands[2]);
-                    operand = get_call_opd(inst->operands[3]);
-                    operand2 = inst->operands[0];
-                    operand3 = inst->operands[1];
-                    if (operand2[0] != 'r' && operand3[0] != 'r') {
-                        if (eval_inst(operand2, operand3, inst->operators[1])) {
-                            output << "\tjmp " << label;
-                        } else {
+                case L1::Operator_Type::CJUMP: {
+                    label = get_call_opd(inst->operands[inst->operand_count - 2]);
+                    operand = get_call_opd(inst->operands[inst->operand_count - 1]);
+                    L1::Operator_Type cmp;
+                    if (get_cmp(inst, 0, operand2, operand3, cmp)) {
+                        operand = operand2 == "1" ? label : operand;
+                        if (operand != next_label) {
                             output << "\tjmp " << operand;
                         }
-                    } else if (operand2[0] != 'r') {
-                        output << "\tcmpq " << get_opd(operand2) << ", " << get_opd(operand3) << endl;
-                        if (inst->operators[1] == L1::Operator_Type::LEQ) {
-                            output << "\tjg ";
-                        } else if (inst->operators[1] == L1::Operator_Type::LQ) {
-                            output << "\tjge ";
-                        } else {
-                            output << "\tje ";
-                        }
-                        output << label << endl << "\tjmp " << operand;
                     } else {
-                        output << "\tcmpq " << get_opd(operand3) << ", " << get_opd(operand2) << endl;
-                        if (inst->operators[1] == L1::Operator_Type::LEQ) {
-                            output << "\tjle ";
-                        } else if (inst->operators[1] == L1::Operator_Type::LQ) {
-                            output << "\tjl ";
+                        operand2 = emit_cmp(output, operand2, operand3, cmp);
+                        if (label == next_label) {
+                            output << "\tj" << invert_condition(operand2) << ' ' << operand;
+                        } else if (operand == next_label) {
+                            output << "\tj" << operand2 << ' ' << label;
                         } else {
-                            output << "\tje ";
+                            output << "\tj" << operand2 << ' ' << label << endl
+                                   << "\tjmp " << operand;
                         }
-                        output << label << endl << "\tjmp " << operand;
                     }
                     break;
+                }
                 case L1::Operator_Type::LABEL:
-                    output << get_label(inst->operands[0]);
+                    output << get_label(L1::label_name(inst->operands[0]));
                     break;
                 case L1::Operator_Type::GOTO:
                     output << "\tjmp " << get_call_opd(inst->operands[0]);
                     break;
                 case L1::Operator_Type::RETURN:
-                    if (f->locals > 0 || f->arguments > 6) {
-                        output << "\taddq $" << (f->arguments > 6 ? f->arguments - 6 + f->locals : f->locals) * 8
-                               << ", %rsp" << endl;
+                    if (f->locals > 0 || (f->arguments > 6 && !native_calls)) {
+                        output << '\t' << L1::select_arith("addq", "$" + to_string(
+                                (f->arguments > 6 && !native_calls ? f->arguments - 6 + f->locals : f->locals) * 8),
+                                                            "%rsp") << endl;
                     }
                     output << "\tretq";
                     break;
                 case L1::Operator_Type::CALL:
-                    output << "\tsubq " + get_call_shift(inst->operands[1]) << ", %rsp" << endl;
-                    output << "\tjmp " + get_call_opd(inst->operands[0]);
+                    if (native_calls) {
+                        /*
+                         * The caller stored the stack arguments right below rsp, and pops
+                         * them itself once the callee returns.
+                         * */
+                        label = "$" + to_string(max(inst->operands[1].value - 6, (int64_t)0) * 8);
+                        if (label != "$0") {
+                            output << '\t' << L1::select_arith("subq", label, "%rsp") << endl;
+                        }
+                        output << "\tcall " + get_call_opd(inst->operands[0]);
+                        if (label != "$0") {
+                            output << endl << '\t' << L1::select_arith("addq", label, "%rsp");
+                        }
+                    } else {
+                        output << '\t' << L1::select_arith("subq", get_call_shift(inst->operands[1]), "%rsp") << endl;
+                        output << "\tjmp " + get_call_opd(inst->operands[0]);
+                    }
                     break;
                 case L1::Operator_Type::PRINT:
                     output << "\tcall print";
@@ -238,19 +325,26 @@ int main(int argc, char **argv) {
                     break;
                 case L1::Operator_Type::CISC:
                     output << "\tlea (" + get_opd(inst->operands[1]) << ", " << get_opd(inst->operands[2])
-                           << ", " << inst->operands[3] << "), " << get_opd(inst->operands[0]);
+                           << ", " << inst->operands[3].value << "), " << get_opd(inst->operands[0]);
                     break;
                 case L1::Operator_Type::MEM:
-                    operand = get_opd(inst->operands[2]);
                     operand2 = get_mem_opd(inst->operands[0], inst->operands[1]);
-                    if (inst->operators[1] == L1::Operator_Type::ADDQ) {
-                        output << "\taddq ";
-                    } else if (inst->operators[1] == L1::Operator_Type::SUBQ) {
-                        output << "\tsubq ";
+                    if (inst->operators[1] == L1::Operator_Type::SALQ || inst->operators[1] == L1::Operator_Type::SARQ) {
+                        output << '\t' << get_arith_op(inst->operators[1]) << ' ' << get_shift_opd(inst->operands[2])
+                               << ", " << operand2;
+                    } else if (inst->operand_count > 2) {
+                        output << '\t' << (inst->operators[1] == L1::Operator_Type::MOVQ
+                                           ? L1::select_movq(get_opd(inst->operands[2]), operand2)
+                                           : L1::select_arith(get_arith_op(inst->operators[1]),
+                                                              get_opd(inst->operands[2]), operand2));
                     } else {
-                        output << "\tmovq ";
+                        output << '\t' << get_arith_op(inst->operators[1]) << ' ' << operand2;
                     }
-                    output << operand << ", " << operand2;
+                    break;
+                case L1::Operator_Type::MEM_INDEX:
+                    output << '\t' << L1::select_movq(get_opd(inst->operands[4]),
+                                                       get_index_opd(inst->operands[0], inst->operands[1],
+                                                                     inst->operands[2], inst->operands[3]));
                     break;
                 case L1::Operator_Type::INC:
                     output << "\tinc " << get_opd(inst->operands[0]);
@@ -268,7 +362,24 @@ int main(int argc, char **argv) {
 
     output << endl;
 
-    output.close();
+    if (keep_assembly) {
+        ofstream assembly("prog.S");
+        assembly << output.str();
+    }
+
+    /* -x runs the program in this process instead of writing prog.o.
+     */
+    if (run) {
+        vector<string> functions;
+        for (auto f : p.functions) {
+            functions.push_back(get_call_opd(f->name));
+        }
+        return L1::run_in_process(output.str(), functions);
+    }
+    if (!L1::assemble(output.str(), "prog.o")) {
+        return 1;
+    }
+    arena::report("L1");
 
     return 0;
 }
@@ -0,0 +1,61 @@
+#include <string>
+
+#include "encoding.h"
+
+using namespace std;
+
+namespace L1 {
+    inline bool is_immediate(const string &opd) {
+        return opd[0] == '$' && (opd[1] == '-' || (opd[1] >= '0' && opd[1] <= '9'));
+    }
+
+    inline bool is_register(const string &opd) {
+        return opd[0] == '%';
+    }
+
+    string get_reg32(const string &reg) {
+        /*
+         * Writing the low 32 bits of a register clears the upper 32 bits.
+         * */
+        if (reg[2] >= '0' && reg[2] <= '9') {
+            return reg + "d";
+        }
+        return "%e" + reg.substr(2);
+    }
+
+    string select_movq(const string &src, const string &dst) {
+        if (is_register(dst) && is_immediate(src)) {
+            int64_t value = stoll(src.substr(1));
+            if (value == 0) {
+                return "xorl " + get_reg32(dst) + ", " + get_reg32(dst);
+            }
+            if (value > 0 && value <= 0xffffffffLL) {
+                return "movl " + src + ", " + get_reg32(dst);
+            }
+        }
+        return "movq " + src + ", " + dst;
+    }
+
+    string select_arith(const string &op, const string &src, const string &dst) {
+        if ((op == "addq" || op == "subq") && is_immediate(src)) {
+            int64_t value = stoll(src.substr(1));
+            if (value == 1 || value == -1) {
+                return ((op == "addq") == (value == 1) ? "incq " : "decq ") + dst;
+            }
+            /*
+             * 128 needs a 32-bit immediate, -128 fits in a byte.
+             * */
+            if (value == 128) {
+                return (op == "addq" ? "subq $-128, " : "addq $-128, ") + dst;
+            }
+        }
+        return op + ' ' + src + ", " + dst;
+    }
+
+    string select_cmpq(const string &src, const string &dst) {
+        if (is_immediate(src) && stoll(src.substr(1)) == 0 && is_register(dst)) {
+            return "testq " + dst + ", " + dst;
+        }
+        return "cmpq " + src + ", " + dst;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace L1 {
+    /*
+     * Shortest encodings of x86 instructions whose operands are already in AT&T syntax. None
+     * of the L1 instructions leaves flags for the next one, so forms that set them
+     * differently are interchangeable.
+     * */
+    std::string select_movq(const std::string &src, const std::string &dst);
+
+    std::string select_arith(const std::string &op, const std::string &src, const std::string &dst);
+
+    std::string select_cmpq(const std::string &src, const std::string &dst);
+}
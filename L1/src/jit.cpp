@@ -0,0 +1,129 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "assembler.h"
+#include "jit.h"
+
+using namespace std;
+
+/*
+ * lib/runtime.c is linked into the compiler with its main renamed. That main records the
+ * bottom of the stack for the collector and calls go, which jumps on into the generated
+ * code without a frame of its own, so the stack looks exactly as in a linked program.
+ * */
+extern "C" {
+    int64_t print(void *l);
+    void *allocate(int64_t fw_size, int64_t *fw_fill);
+    int array_error(int64_t *array, int64_t fw_x);
+    int l1_runtime_main();
+
+    void *l1_jit_entry;
+}
+
+asm(".text\n"
+    ".globl go\n"
+    "go:\n"
+    "\tjmp *l1_jit_entry(%rip)\n");
+
+namespace L1 {
+    const map<string, void *> runtime_functions = {
+            {"print",       (void *)print},
+            {"allocate",    (void *)allocate},
+            {"array_error", (void *)array_error}
+    };
+
+    /*
+     * jmp *0(%rip) followed by the absolute address, so calls reach the runtime however far
+     * the code is mapped from the compiler.
+     * */
+    const int stub_size = 14;
+
+    void write_perf_map(const Machine_Code &code, uint64_t base, const vector<string> &functions,
+                        const map<string, int64_t> &stubs) {
+        vector<pair<int64_t, string>> starts;
+        for (auto const &f : functions) {
+            if (code.labels.count(f) > 0) {
+                starts.push_back(make_pair(code.labels.at(f), f));
+            }
+        }
+        if (code.labels.count("go") > 0) {
+            starts.push_back(make_pair(code.labels.at("go"), string("go")));
+        }
+        sort(starts.begin(), starts.end());
+
+        ofstream map_file("/tmp/perf-" + to_string(getpid()) + ".map");
+        map_file << hex;
+        for (int i = 0; i < starts.size(); i++) {
+            int64_t end = i + 1 < starts.size() ? starts[i + 1].first : code.text.size();
+            map_file << base + starts[i].first << ' ' << end - starts[i].first << ' ' << starts[i].second << '\n';
+        }
+        for (auto const &stub : stubs) {
+            map_file << base + stub.second << ' ' << stub_size << ' ' << stub.first << "@stub\n";
+        }
+    }
+
+    int run_in_process(const string &assembly, const vector<string> &functions) {
+        Machine_Code code;
+        if (!encode_assembly(assembly, code)) {
+            return 1;
+        }
+
+        map<string, int64_t> stubs;
+        int64_t size = (code.text.size() + 7) / 8 * 8;
+        for (auto const &r : code.relocations) {
+            if (!r.symbol.empty() && stubs.count(r.symbol) == 0) {
+                if (runtime_functions.count(r.symbol) == 0) {
+                    cerr << "L1 jit: unknown function " << r.symbol << endl;
+                    return 1;
+                }
+                stubs[r.symbol] = size;
+                size += stub_size;
+            }
+        }
+
+        /*
+         * Label addresses are 32-bit immediates, so the code has to live in the low 2GB.
+         * */
+        int64_t page = sysconf(_SC_PAGESIZE);
+        size_t mapped = (size + page - 1) / page * page;
+        void *memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+        if (memory == MAP_FAILED) {
+            cerr << "L1 jit: cannot map " << mapped << " bytes" << endl;
+            return 1;
+        }
+        uint8_t *base = (uint8_t *)memory;
+        memcpy(base, code.text.data(), code.text.size());
+        for (auto const &stub : stubs) {
+            uint8_t jump[6] = {0xff, 0x25, 0, 0, 0, 0};
+            uint64_t target = (uint64_t)runtime_functions.at(stub.first);
+            memcpy(base + stub.second, jump, 6);
+            memcpy(base + stub.second + 6, &target, 8);
+        }
+        for (auto const &r : code.relocations) {
+            int32_t value = r.type == R_X86_64_32S
+                            ? (int32_t)((uint64_t)base + r.addend)
+                            : (int32_t)(stubs[r.symbol] + r.addend - r.offset);
+            memcpy(base + r.offset, &value, 4);
+        }
+        if (mprotect(memory, mapped, PROT_READ | PROT_EXEC) != 0) {
+            cerr << "L1 jit: cannot make the code executable" << endl;
+            return 1;
+        }
+
+        write_perf_map(code, (uint64_t)base, functions, stubs);
+        l1_jit_entry = base + code.labels["go"];
+        int status = l1_runtime_main();
+        cout.flush();
+        fflush(stdout);
+        munmap(memory, mapped);
+        return status;
+    }
+}
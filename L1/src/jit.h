@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace L1 {
+    /*
+     * Encodes the assembly into executable memory and runs it on the runtime linked into the
+     * compiler, as a.out would. functions are the labels listed in the perf map of the
+     * process. Returns the exit status of the program.
+     * */
+    int run_in_process(const std::string &assembly, const std::vector<std::string> &functions);
+}
@@ -0,0 +1,153 @@
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "layout.h"
+
+using namespace std;
+
+namespace L1 {
+    struct Block {
+        vector<Instruction *> instructions;
+        vector<int> successors;
+        int depth = 0;
+    };
+
+    struct Edge {
+        int from, to;
+        int64_t weight;
+    };
+
+    inline bool ends_block(const Instruction *inst) {
+        switch (inst->operators[0]) {
+            case Operator_Type::GOTO:
+            case Operator_Type::CJUMP:
+            case Operator_Type::RETURN:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline bool falls_through(const Block &b) {
+        /*
+         * A call counts as falling through to its return label. With call/ret it really
+         * does, and when calls jump the goto that may follow one is never reached.
+         * */
+        return b.instructions.empty() || !ends_block(b.instructions.back());
+    }
+
+    vector<Block> split_blocks(Function *f) {
+        vector<Block> blocks;
+        for (auto inst : f->instructions) {
+            if (blocks.empty() || inst->operators[0] == Operator_Type::LABEL ||
+                    (!blocks.back().instructions.empty() && ends_block(blocks.back().instructions.back()))) {
+                blocks.push_back(Block());
+            }
+            blocks.back().instructions.push_back(inst);
+        }
+        map<int32_t, int> block_of;
+        for (int b = 0; b < blocks.size(); b++) {
+            Instruction *first = blocks[b].instructions.front();
+            if (first->operators[0] == Operator_Type::LABEL) {
+                block_of[first->operands[0].id] = b;
+            }
+        }
+        for (int b = 0; b < blocks.size(); b++) {
+            Instruction *last = blocks[b].instructions.back();
+            vector<int32_t> targets;
+            if (last->operators[0] == Operator_Type::GOTO) {
+                targets.push_back(last->operands[0].id);
+            } else if (last->operators[0] == Operator_Type::CJUMP) {
+                targets.push_back(last->operands[last->operand_count - 2].id);
+                targets.push_back(last->operands[last->operand_count - 1].id);
+            }
+            for (auto const &t : targets) {
+                if (block_of.count(t) > 0) {
+                    blocks[b].successors.push_back(block_of[t]);
+                }
+            }
+            if (b + 1 < blocks.size() && falls_through(blocks[b])) {
+                blocks[b].successors.push_back(b + 1);
+            }
+        }
+        /*
+         * Every backward edge closes a loop over the blocks in between.
+         * */
+        for (int b = 0; b < blocks.size(); b++) {
+            for (int s : blocks[b].successors) {
+                if (s <= b) {
+                    for (int l = s; l <= b; l++) {
+                        blocks[l].depth++;
+                    }
+                }
+            }
+        }
+        return blocks;
+    }
+
+    void layout_blocks(Function *f) {
+        /*
+         * Pettis-Hansen: edges are taken by decreasing estimated frequency, and the chain
+         * ending with the source is glued to the chain starting with the destination so
+         * that the edge becomes a fallthrough. Frequencies are guessed from loop depth.
+         * */
+        vector<Block> blocks = split_blocks(f);
+        int n = blocks.size();
+        if (n < 3) {
+            return;
+        }
+        vector<Edge> edges;
+        for (int b = 0; b < n; b++) {
+            for (int s : blocks[b].successors) {
+                int64_t weight = 1;
+                for (int d = min(blocks[b].depth, blocks[s].depth); d > 0 && weight < 1000000; d--) {
+                    weight *= 10;
+                }
+                edges.push_back({b, s, weight});
+            }
+        }
+        stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.weight > b.weight; });
+
+        vector<int> next(n, -1), prev(n, -1), head(n);
+        for (int b = 0; b < n; b++) {
+            head[b] = b;
+        }
+        for (auto const &e : edges) {
+            if (e.to == 0 || next[e.from] != -1 || prev[e.to] != -1 || head[e.from] == head[e.to]) {
+                continue;
+            }
+            next[e.from] = e.to;
+            prev[e.to] = e.from;
+            for (int b = e.to; b != -1; b = next[b]) {
+                head[b] = head[e.from];
+            }
+        }
+
+        /*
+         * The entry chain goes first, the others keep their original order.
+         * */
+        vector<int> order;
+        for (int b = 0; b < n; b++) {
+            if (prev[b] == -1) {
+                for (int c = b; c != -1; c = next[c]) {
+                    order.push_back(c);
+                }
+            }
+        }
+
+        vector<Instruction *> instructions;
+        for (int i = 0; i < n; i++) {
+            Block &b = blocks[order[i]];
+            instructions.insert(instructions.end(), b.instructions.begin(), b.instructions.end());
+            bool next_is_successor = i + 1 < n && order[i + 1] == order[i] + 1;
+            if (falls_through(b) && order[i] + 1 < n && !next_is_successor) {
+                Instruction *jump = new Instruction;
+                jump->operators[jump->operator_count++] = Operator_Type::GOTO;
+                jump->operands[jump->operand_count++] = blocks[order[i] + 1].instructions.front()->operands[0];
+                instructions.push_back(jump);
+            }
+        }
+        f->instructions = instructions;
+    }
+}
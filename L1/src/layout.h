@@ -0,0 +1,7 @@
+#pragma once
+
+#include <L1.h>
+
+namespace L1 {
+    void layout_blocks(Function *f);
+}
@@ -0,0 +1,19 @@
+#include <string>
+
+#include "L1.h"
+
+using namespace std;
+
+namespace L1 {
+    const char *const register_names[register_count] = {"rax", "rdi", "rsi", "rdx", "rcx", "r8", "r9", "r10",
+                                                        "r11", "r12", "r13", "r14", "r15", "rbp", "rbx", "rsp"};
+
+    int32_t register_id(const string &name) {
+        for (int32_t i = 0; i < register_count; i++) {
+            if (name == register_names[i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+}
@@ -9,6 +9,7 @@
 #include <cstdlib>
 #include <stdint.h>
 #include <assert.h>
+#include <iostream>
 
 #include <L1.h>
 #include <pegtl.hh>
@@ -110,7 +111,7 @@ namespace L1 {
 
     struct operand_s : pegtl::sor<operand_t, label> {};
 
-    struct operand_E : pegtl::sor<pegtl::one<'0'>, pegtl::one<'2'>, pegtl::one<'4'>, pegtl::one<'8'>> {};
+    struct operand_E : pegtl::sor<pegtl::one<'1'>, pegtl::one<'2'>, pegtl::one<'4'>, pegtl::one<'8'>> {};
 
     struct operand_M : number {};
 
@@ -166,6 +167,18 @@ namespace L1 {
 
     struct inst_mem : pegtl::seq<pegtl::one<'('>, seps, mem, seps, x, seps, M, seps, pegtl::one<')'>> {};
 
+    struct mem_index : pegtl::string<'m', 'e', 'm'> {};
+
+    /*
+     * (mem x w E M) addresses x + w * E + M. The lookahead runs without actions, so a plain
+     * (mem x M) leaves no operands behind when it does not match.
+     * */
+    struct inst_mem_index :
+        pegtl::seq<
+            pegtl::at<pegtl::one<'('>, seps, mem, seps, operand_x, seps, operand_w, seps, operand_E, seps, operand_M, seps, pegtl::one<')'>>,
+            pegtl::one<'('>, seps, mem_index, seps, x, seps, w, seps, E, seps, M, seps, pegtl::one<')'>
+        > {};
+
     struct inst_cjump : pegtl::string<'c', 'j', 'u', 'm', 'p'> {};
 
     struct inst_return : pegtl::string<'r', 'e', 't', 'u', 'r', 'n'> {};
@@ -205,22 +218,39 @@ namespace L1 {
                             operator_inc, operator_dec,
                             pegtl::seq<
                                 operator_movq, seps,
-                                pegtl::sor<pegtl::seq<t, seps, operator_cmp, seps, t>, s, inst_mem>
+                                pegtl::sor<
+                                    pegtl::seq<t, seps, operator_cmp, seps, pegtl::sor<t, inst_mem>>,
+                                    s,
+                                    inst_mem_index,
+                                    pegtl::seq<inst_mem, pegtl::opt<seps, operator_cmp, seps, t>>
+                                >
                             >,
                             pegtl::seq<operator_at, seps, w, seps, w, seps, E>,
                             pegtl::seq<operator_sop, seps, operand_sop>,
-                            pegtl::seq<pegtl::sor<operator_addq, operator_subq>, seps, pegtl::sor<t, inst_mem>>,
-                            pegtl::seq<pegtl::sor<operator_imulq, operator_andq>, seps, t>
+                            pegtl::seq<
+                                pegtl::sor<operator_addq, operator_subq, operator_imulq, operator_andq>, seps,
+                                pegtl::sor<t, inst_mem>
+                            >
                         >
                     >,
+                    pegtl::seq<inst_mem_index, seps, operator_movq, seps, s>,
                     pegtl::seq<
                         inst_mem, seps,
                         pegtl::sor<
+                            operator_inc, operator_dec,
                             pegtl::seq<operator_movq, seps, s>,
-                            pegtl::seq<pegtl::sor<operator_addq, operator_subq>, seps, t>
+                            pegtl::seq<operator_sop, seps, operand_sop>,
+                            pegtl::seq<pegtl::sor<operator_addq, operator_subq, operator_andq>, seps, t>
                         >
                     >,
-                    pegtl::seq<inst_cjump, seps, t, seps, operator_cmp, seps, t, seps, inst_cjump_label, seps, inst_cjump_label>,
+                    pegtl::seq<
+                        inst_cjump, seps,
+                        pegtl::sor<
+                            pegtl::seq<t, seps, operator_cmp, seps, pegtl::sor<t, inst_mem>>,
+                            pegtl::seq<inst_mem, seps, operator_cmp, seps, t>
+                        >,
+                        seps, inst_cjump_label, seps, inst_cjump_label
+                    >,
                     pegtl::seq<inst_goto, seps, goto_label>,
                     inst_return,
                     pegtl::seq<
@@ -285,6 +315,37 @@ namespace L1 {
      */
     std::vector <L1_item> parsed_registers;
 
+    void push_operand(Program &p, const pegtl::input &in) {
+        Instruction *inst = p.functions.back()->instructions.back();
+        if (inst->operand_count == 5) {
+            cerr << "\tERROR L1: instruction with more than 5 operands" << endl;
+            abort();
+        }
+        Operand &o = inst->operands[inst->operand_count++];
+        const char *s = in.begin();
+        o.value = 0;
+        if (s[0] == '+' || s[0] == '-' || (s[0] >= '0' && s[0] <= '9')) {
+            o.kind = NUMBER;
+            o.id = -1;
+            o.value = strtoll(s, NULL, 10);
+        } else if (s[0] == ':') {
+            o.kind = LABEL_NAME;
+            o.id = symbol::Symbol(s, in.size()).id();
+        } else {
+            o.kind = REGISTER;
+            o.id = register_id(in.string());
+        }
+    }
+
+    void push_operator(Program &p, Operator_Type op) {
+        Instruction *inst = p.functions.back()->instructions.back();
+        if (inst->operator_count == 3) {
+            cerr << "\tERROR L1: instruction with more than 3 operators" << endl;
+            abort();
+        }
+        inst->operators[inst->operator_count++] = op;
+    }
+
     /*
      * Actions attached to grammar rules.
      */
@@ -341,56 +402,56 @@ namespace L1 {
     template<>
     struct action<w> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<s> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<t> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<u> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<x> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<E> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<M> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
 template<>
 struct action<operand_sop> {
     static void apply(const pegtl::input &in, L1::Program &p) {
-        p.functions.back()->instructions.back()->operands.push_back(in.string());
+        push_operand(p, in);
     }
 };
 
@@ -400,8 +461,8 @@ struct action<operand_sop> {
             L1::Function *currentF = p.functions.back();
             L1::Instruction *newI = new L1::Instruction();
             currentF->instructions.push_back(newI);
-            newI->operators.push_back(L1::Operator_Type::LABEL);
-            newI->operands.push_back(in.string());
+            push_operator(p, L1::Operator_Type::LABEL);
+            push_operand(p, in);
         }
     };
 
@@ -429,133 +490,140 @@ struct action<operand_sop> {
     template<>
     struct action<operator_movq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::MOVQ);
+            push_operator(p, L1::Operator_Type::MOVQ);
         }
     };
 
     template<>
     struct action<mem> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::MEM);
+            push_operator(p, L1::Operator_Type::MEM);
+        }
+    };
+
+    template<>
+    struct action<mem_index> {
+        static void apply(const pegtl::input &in, L1::Program &p) {
+            push_operator(p, L1::Operator_Type::MEM_INDEX);
         }
     };
 
     template<>
     struct action<operator_addq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::ADDQ);
+            push_operator(p, L1::Operator_Type::ADDQ);
         }
     };
 
     template<>
     struct action<operator_subq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::SUBQ);
+            push_operator(p, L1::Operator_Type::SUBQ);
         }
     };
 
     template<>
     struct action<operator_imulq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::IMULQ);
+            push_operator(p, L1::Operator_Type::IMULQ);
         }
     };
 
     template<>
     struct action<operator_andq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::ANDQ);
+            push_operator(p, L1::Operator_Type::ANDQ);
         }
     };
 
     template<>
     struct action<operator_salq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::SALQ);
+            push_operator(p, L1::Operator_Type::SALQ);
         }
     };
 
     template<>
     struct action<operator_lq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::LQ);
+            push_operator(p, L1::Operator_Type::LQ);
         }
     };
 
     template<>
     struct action<operator_leq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::LEQ);
+            push_operator(p, L1::Operator_Type::LEQ);
         }
     };
 
     template<>
     struct action<operator_eq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::EQ);
+            push_operator(p, L1::Operator_Type::EQ);
         }
     };
 
     template<>
     struct action<operator_inc> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::INC);
+            push_operator(p, L1::Operator_Type::INC);
         }
     };
 
     template<>
     struct action<operator_dec> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::DEC);
+            push_operator(p, L1::Operator_Type::DEC);
         }
     };
 
     template<>
     struct action<operator_sarq> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::SARQ);
+            push_operator(p, L1::Operator_Type::SARQ);
         }
     };
 
 template<>
 struct action<operator_at> {
     static void apply(const pegtl::input &in, L1::Program &p) {
-        p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::CISC);
+        push_operator(p, L1::Operator_Type::CISC);
     }
 };
 
     template<>
     struct action<inst_goto> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::GOTO);
+            push_operator(p, L1::Operator_Type::GOTO);
         }
     };
 
     template<>
     struct action<goto_label> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<inst_return> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::RETURN);
+            push_operator(p, L1::Operator_Type::RETURN);
         }
     };
 
     template<>
     struct action<inst_call> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::CALL);
+            push_operator(p, L1::Operator_Type::CALL);
         }
     };
 
     template<>
     struct action<inst_call_number> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
@@ -563,10 +631,8 @@ struct action<operator_at> {
     struct action<inst_print> {
         static void apply(const pegtl::input &in, L1::Program &p) {
             L1::Instruction *currentI = p.functions.back()->instructions.back();
-            if (!currentI->operators.empty()) {
-                currentI->operators.clear();
-            }
-            currentI->operators.push_back(L1::Operator_Type::PRINT);
+            currentI->operator_count = 0;
+            push_operator(p, L1::Operator_Type::PRINT);
         }
     };
 
@@ -574,10 +640,8 @@ struct action<operator_at> {
     struct action<inst_allocate> {
         static void apply(const pegtl::input &in, L1::Program &p) {
             L1::Instruction *currentI = p.functions.back()->instructions.back();
-            if (!currentI->operators.empty()) {
-                currentI->operators.clear();
-            }
-            currentI->operators.push_back(L1::Operator_Type::ALLOCATE);
+            currentI->operator_count = 0;
+            push_operator(p, L1::Operator_Type::ALLOCATE);
         }
     };
 
@@ -585,24 +649,22 @@ struct action<operator_at> {
     struct action<inst_array_error> {
         static void apply(const pegtl::input &in, L1::Program &p) {
             L1::Instruction *currentI = p.functions.back()->instructions.back();
-            if (!currentI->operators.empty()) {
-                currentI->operators.clear();
-            }
-            currentI->operators.push_back(L1::Operator_Type::ARRAY_ERROR);
+            currentI->operator_count = 0;
+            push_operator(p, L1::Operator_Type::ARRAY_ERROR);
         }
     };
 
     template<>
     struct action<inst_cjump> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(L1::Operator_Type::CJUMP);
+            push_operator(p, L1::Operator_Type::CJUMP);
         }
     };
 
     template<>
     struct action<inst_cjump_label> {
         static void apply(const pegtl::input &in, L1::Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
@@ -0,0 +1,133 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "peephole.h"
+
+using namespace std;
+
+namespace L1 {
+    const vector<Peephole_Rule> peephole_rules = {
+            {"self-move",
+                    {{{MOVQ}, {"?a", "?a"}}},
+                    {}},
+            {"goto-next-label",
+                    {{{GOTO}, {"?l"}}, {{LABEL}, {"?l"}}},
+                    {{{LABEL}, {"?l"}}}},
+            {"reload-after-store",
+                    {{{MEM, MOVQ}, {"?x", "?m", "?a"}}, {{MOVQ, MEM}, {"?b", "?x", "?m"}}},
+                    {{{MEM, MOVQ}, {"?x", "?m", "?a"}}, {{MOVQ}, {"?b", "?a"}}}},
+            {"add-zero",
+                    {{{ADDQ}, {"?a", "0"}}},
+                    {}},
+            {"sub-zero",
+                    {{{SUBQ}, {"?a", "0"}}},
+                    {}},
+            {"mul-one",
+                    {{{IMULQ}, {"?a", "1"}}},
+                    {}},
+            {"and-all-ones",
+                    {{{ANDQ}, {"?a", "-1"}}},
+                    {}},
+            {"shift-left-zero",
+                    {{{SALQ}, {"?a", "0"}}},
+                    {}},
+            {"shift-right-zero",
+                    {{{SARQ}, {"?a", "0"}}},
+                    {}},
+    };
+
+    /*
+     * Operands bound to the pattern variables ?a to ?z, unbound ones have no kind.
+     * */
+    struct Bindings {
+        Operand operands[26] = {};
+
+        inline Operand &operator[](const string &variable) {
+            return operands[variable[1] - 'a'];
+        }
+    };
+
+    bool match_operand(const string &pattern, const Operand &operand, Bindings &bindings) {
+        if (pattern[0] == '?') {
+            Operand &bound = bindings[pattern];
+            if (bound.kind == NO_OPERAND) {
+                bound = operand;
+                return true;
+            }
+            return bound == operand;
+        }
+        return operand.kind == NUMBER && operand.value == stoll(pattern);
+    }
+
+    bool match(const Peephole_Rule &rule, const vector<Instruction *> &instructions, int start, Bindings &bindings) {
+        if (start + rule.pattern.size() > instructions.size()) {
+            return false;
+        }
+        for (int i = 0; i < rule.pattern.size(); i++) {
+            const Peephole_Pattern &pattern = rule.pattern[i];
+            Instruction *inst = instructions[start + i];
+            if (inst->operator_count != pattern.operators.size() ||
+                    !equal(pattern.operators.begin(), pattern.operators.end(), inst->operators) ||
+                    inst->operand_count < pattern.operands.size()) {
+                return false;
+            }
+            for (int j = 0; j < pattern.operands.size(); j++) {
+                if (!match_operand(pattern.operands[j], inst->operands[j], bindings)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    Instruction *instantiate(const Peephole_Pattern &pattern, Bindings &bindings) {
+        Instruction *inst = new Instruction;
+        for (auto op : pattern.operators) {
+            inst->operators[inst->operator_count++] = op;
+        }
+        for (auto const &operand : pattern.operands) {
+            inst->operands[inst->operand_count++] = operand[0] == '?' ? bindings[operand]
+                                                                      : Operand{NUMBER, -1, stoll(operand)};
+        }
+        return inst;
+    }
+
+    map<string, int64_t> peephole(Program &p) {
+        /*
+         * Rewrites every function until no rule matches anymore, the first matching rule in
+         * peephole_rules wins. A replacement can enable a rule that ends right after it, so
+         * scanning resumes far enough back to see it.
+         * */
+        map<string, int64_t> fired;
+        int longest = 1;
+        for (auto const &rule : peephole_rules) {
+            fired[rule.name] = 0;
+            longest = max(longest, (int)rule.pattern.size());
+        }
+        for (auto f : p.functions) {
+            vector<Instruction *> &instructions = f->instructions;
+            int i = 0;
+            while (i < instructions.size()) {
+                bool rewritten = false;
+                for (auto const &rule : peephole_rules) {
+                    Bindings bindings;
+                    if (match(rule, instructions, i, bindings)) {
+                        vector<Instruction *> replacement;
+                        for (auto const &pattern : rule.replacement) {
+                            replacement.push_back(instantiate(pattern, bindings));
+                        }
+                        instructions.erase(instructions.begin() + i, instructions.begin() + i + rule.pattern.size());
+                        instructions.insert(instructions.begin() + i, replacement.begin(), replacement.end());
+                        fired[rule.name]++;
+                        rewritten = true;
+                        break;
+                    }
+                }
+                i = rewritten ? max(0, i - longest + 1) : i + 1;
+            }
+        }
+        return fired;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <L1.h>
+
+namespace L1 {
+    /*
+     * Shape of one instruction in a rule. Operands are either pattern variables ?a to ?z,
+     * every occurrence of which in a rule stands for the same operand, or numbers, which
+     * match by value. The parser can leave extra operands behind the ones an instruction
+     * uses, so only the leading operands are matched.
+     * */
+    struct Peephole_Pattern {
+        std::vector<L1::Operator_Type> operators;
+        std::vector<std::string> operands;
+    };
+
+    /*
+     * Consecutive instructions matching pattern are replaced by replacement.
+     * */
+    struct Peephole_Rule {
+        std::string name;
+        std::vector<Peephole_Pattern> pattern;
+        std::vector<Peephole_Pattern> replacement;
+    };
+
+    extern const std::vector<Peephole_Rule> peephole_rules;
+
+    std::map<std::string, int64_t> peephole(Program &p);
+}
@@ -0,0 +1,76 @@
+#!/bin/bash
+#
+# Compile time of a synthetic program with many large functions for several thread
+# counts. The generated L1 must be the same whatever the number of threads.
+#
+# usage: ./scripts/benchmark.sh [FUNCTIONS] [BLOCKS_PER_FUNCTION]
+
+functions=${1:-100} ;
+blocks=${2:-20} ;
+dir=$(mktemp -d) ;
+compiler=$(pwd)/bin/L2 ;
+
+awk -v functions=$functions -v blocks=$blocks 'BEGIN {
+  print "(:go" ;
+  print "  (:go" ;
+  print "    0 0" ;
+  print "    (rdi <- 201)" ;
+  print "    (rsi <- 1)" ;
+  print "    (call allocate 2)" ;
+  print "    (p <- rax)" ;
+  print "    (acc <- 0)" ;
+  for (f = 0; f < functions; f++) {
+    print "    ((mem rsp -8) <- :go_ret" f ")" ;
+    print "    (rdi <- p)" ;
+    print "    (call :f" f " 1)" ;
+    print "    :go_ret" f ;
+    print "    (acc += rax)" ;
+  }
+  print "    (acc &= 1023)" ;
+  print "    (acc <<= 1)" ;
+  print "    (acc++)" ;
+  print "    (rdi <- acc)" ;
+  print "    (call print 1)" ;
+  print "    (return)" ;
+  print "  )" ;
+  for (f = 0; f < functions; f++) {
+    print "  (:f" f ;
+    print "    1 0" ;
+    print "    (p <- rdi)" ;
+    print "    (acc <- " f ")" ;
+    print "    (g1 <- 3)" ;
+    print "    (g2 <- 5)" ;
+    for (b = 0; b < blocks; b++) {
+      print "    :f" f "_b" b ;
+      for (k = 0; k < 8; k++) {
+        print "    (t" k " <- (mem p " 8 * (1 + (f + b + k) % 100) "))" ;
+      }
+      for (k = 0; k < 8; k++) {
+        print "    (t" k " += g" 1 + k % 2 ")" ;
+        print "    (acc += t" k ")" ;
+      }
+      print "    ((mem p " 8 * (1 + b % 100) ") <- acc)" ;
+      print "    (cjump acc < 0 :f" f "_b" b " :f" f "_n" b ")" ;
+      print "    :f" f "_n" b ;
+    }
+    print "    (rax <- acc)" ;
+    print "    (return)" ;
+    print "  )" ;
+  }
+  print ")" ;
+}' > ${dir}/bench.L2 ;
+
+echo "$functions functions of $blocks blocks, $(grep -c '' ${dir}/bench.L2) lines" ;
+pushd ${dir} > /dev/null ;
+for threads in 1 2 4 8 ; do
+  start=$(date +%s.%N) ;
+  ${compiler} -j ${threads} bench.L2 ;
+  end=$(date +%s.%N) ;
+  mv prog.L1 prog.${threads}.L1 ;
+  echo "  -j ${threads}: $(awk "BEGIN { printf \"%.2f\", $end - $start }") s" ;
+  if ! cmp -s prog.1.L1 prog.${threads}.L1 ; then
+    echo "  output differs from -j 1" ;
+  fi
+done
+popd > /dev/null ;
+rm -rf ${dir} ;
@@ -11,10 +11,10 @@ for i in *.L2 ; do
   fi
   echo $i ;
 
-  # Generate the binary
+  # Generate the binary, with the options in ${i}.flags if there is one
   pushd ./ ;
   cd ../ ;
-  ./L2c tests/${i} ;
+  ./L2c `cat tests/${i}.flags 2> /dev/null` tests/${i} ;
   ./a.out &> tests/${i}.out.tmp ;
   cmp tests/${i}.out.tmp tests/${i}.out ;
   if ! test $? -eq 0 ; then
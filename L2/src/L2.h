@@ -1,27 +1,207 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <initializer_list>
+#include <arena.h>
+#include <symbol.h>
 
 namespace L2 {
 
     enum Operator_Type {
         EMPTY, MOVQ, ADDQ, SUBQ, IMULQ, ANDQ, SALQ, SARQ,
         CJUMP, LABEL, GOTO, RETURN, CALL, CISC, MEM, INC,
-        DEC, LQ, EQ, LEQ, STACK_ARG
+        DEC, LQ, EQ, LEQ, STACK_ARG, MEM_INDEX
     };
 
-    struct Instruction {
-        std::vector<Operator_Type> operators;
-        std::vector<std::string> operands;
+    enum Operand_Kind : uint8_t {
+        NO_OPERAND, REGISTER, VARIABLE, NUMBER, LABEL_NAME, RUNTIME_FUNCTION
     };
 
-    struct Function {
+    /*
+     * Registers and variables share the id space of Function::names, the registers come
+     * first in the order of register_names. Labels and runtime functions index
+     * Function::labels. Numbers only have a value.
+     * */
+    struct Operand {
+        Operand_Kind kind;
+        int32_t id;
+        int64_t value;
+    };
+
+    inline bool operator==(const Operand &a, const Operand &b) {
+        return a.kind == b.kind && a.id == b.id && a.value == b.value;
+    }
+
+    inline bool operator!=(const Operand &a, const Operand &b) {
+        return !(a == b);
+    }
+
+    inline bool is_name(const Operand &o) {
+        return o.kind == REGISTER || o.kind == VARIABLE;
+    }
+
+    const int32_t register_count = 16;
+
+    extern const char *const register_names[register_count];
+
+    const int32_t rsp_id = 15;
+
+    int32_t register_id(const std::string &name);
+
+    inline Operand make_register(int32_t id) {
+        return {REGISTER, id, 0};
+    }
+
+    inline Operand make_number(int64_t value) {
+        return {NUMBER, -1, value};
+    }
+
+    /*
+     * Marks the copies insert_callee_saves adds, so they can still be found once they
+     * have been allocated.
+     * */
+    enum Callee_Save_Mark : uint8_t {
+        NO_MARK, SAVE_MARK, RESTORE_MARK
+    };
+
+    struct Instruction : arena::Node {
+        Operator_Type operators[3];
+        Operand operands[5];
+        uint8_t operator_count = 0;
+        uint8_t operand_count = 0;
+        Callee_Save_Mark mark = NO_MARK;
+    };
+
+    /*
+     * Overwrites inst, returns true so rewrites can end with it.
+     * */
+    bool set_instruction(Instruction *inst, std::initializer_list<Operator_Type> operators,
+                         std::initializer_list<Operand> operands);
+
+    Instruction *new_instruction(std::initializer_list<Operator_Type> operators, std::initializer_list<Operand> operands);
+
+    inline bool uses_operand(const Instruction *inst, const Operand &o) {
+        for (int j = 0; j < inst->operand_count; j++) {
+            if (inst->operands[j] == o) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline bool writes_first_operand(const Instruction *inst) {
+        switch (inst->operators[0]) {
+            case Operator_Type::MOVQ:
+            case Operator_Type::ADDQ:
+            case Operator_Type::SUBQ:
+            case Operator_Type::IMULQ:
+            case Operator_Type::ANDQ:
+            case Operator_Type::SALQ:
+            case Operator_Type::SARQ:
+            case Operator_Type::INC:
+            case Operator_Type::DEC:
+            case Operator_Type::CISC:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline bool reads_first_operand(const Instruction *inst) {
+        return writes_first_operand(inst) && inst->operators[0] != Operator_Type::MOVQ &&
+               inst->operators[0] != Operator_Type::CISC;
+    }
+
+    inline int mem_operand_index(const Instruction *inst) {
+        /*
+         * Index in operands of the base register of the memory operand of inst, the offset
+         * is the operand right after it. Returns -1 if inst does not access memory.
+         * */
+        const Operator_Type *ops = inst->operators;
+        int count = inst->operator_count;
+        switch (ops[0]) {
+            case Operator_Type::MEM:
+                return 0;
+            case Operator_Type::MOVQ:
+            case Operator_Type::ADDQ:
+            case Operator_Type::SUBQ:
+            case Operator_Type::IMULQ:
+            case Operator_Type::ANDQ:
+                return count > 1 && ops[1] == Operator_Type::MEM ? 1 :
+                       (count > 2 && ops[2] == Operator_Type::MEM ? 2 : -1);
+            case Operator_Type::CJUMP:
+                return ops[1] == Operator_Type::MEM ? 0 : (count > 2 && ops[2] == Operator_Type::MEM ? 1 : -1);
+            default:
+                return -1;
+        }
+    }
+
+    inline bool is_address_register(const Instruction *inst, int j) {
+        /*
+         * Whether operands[j] is the base or the index of a (mem x w E M) operand. Those are
+         * only used by plain loads ((w <- (mem x w E M))) and stores (((mem x w E M) <- s)).
+         * */
+        const Operator_Type *ops = inst->operators;
+        return (ops[0] == Operator_Type::MEM_INDEX && j < 2) ||
+               (inst->operator_count == 2 && ops[1] == Operator_Type::MEM_INDEX && (j == 1 || j == 2));
+    }
+
+    inline int frame_offset_index(const Instruction *inst) {
+        /*
+         * Index in operands of the offset of an rsp based memory operand of inst, either a
+         * plain (mem rsp M) or a (mem rsp w E M). Returns -1 if inst does not address the
+         * frame that way.
+         * */
+        int base = mem_operand_index(inst), offset = base + 1;
+        if (inst->operators[0] == Operator_Type::MEM_INDEX) {
+            base = 0, offset = 3;
+        } else if (inst->operator_count == 2 && inst->operators[1] == Operator_Type::MEM_INDEX) {
+            base = 1, offset = 4;
+        }
+        return base != -1 && inst->operands[base] == make_register(rsp_id) ? offset : -1;
+    }
+
+    inline Operator_Type cmp_operator(const Instruction *inst) {
+        /*
+         * Comparison of a cjump or of a comparison assignment, either side of which can
+         * be a memory operand.
+         * */
+        return inst->operators[1] == Operator_Type::MEM ? inst->operators[2] : inst->operators[1];
+    }
+
+    struct Function : arena::Node {
         std::string name;
         int64_t arguments;
         int64_t locals;
         std::vector<Instruction *> instructions;
+        std::vector<symbol::Symbol> names;
+        std::vector<symbol::Symbol> labels;
     };
 
+    /*
+     * A fresh variable of f, passes that need a temporary make one here.
+     * */
+    Operand new_variable(Function *f, const std::string &name);
+
+    /*
+     * Renumbers the variables of f densely and returns the old id of every new one.
+     * Spilling leaves the names it replaced behind, and every bit vector over the ids
+     * would grow with them.
+     * */
+    std::vector<int32_t> drop_unused_names(Function *f);
+
+    /*
+     * Copy of f without instructions sharing its names, for passes that rebuild the
+     * instruction list of a function.
+     * */
+    Function *empty_copy(const Function *f);
+
+    inline const symbol::Symbol &operand_name(const Function *f, const Operand &o) {
+        return o.kind == LABEL_NAME || o.kind == RUNTIME_FUNCTION ? f->labels[o.id] : f->names[o.id];
+    }
+
     struct Program {
         std::string entryPointLabel;
         std::vector<Function *> functions;
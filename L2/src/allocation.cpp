@@ -0,0 +1,335 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <iostream>
+
+#include "L2.h"
+#include "liveness.h"
+#include "interference.h"
+#include "coloring.h"
+#include "spill.h"
+#include "callee_save.h"
+#include "clobbers.h"
+
+using namespace std;
+
+namespace L2 {
+    Function *allocate_registers(Function *f) {
+        vector<int32_t> colors;
+        vector<int32_t> spill_ids;
+        uint32_t written = written_registers(f);
+        do {
+            colors.clear();
+            spill_ids.clear();
+            f = rematerialize(f, rematerializable_variables(f));
+            drop_unused_names(f);
+            vector<bool> call_crossing = call_crossing_variables(f);
+            Interference_Graph graph = compute_interference_graph(f);
+            graph_coloring(f, graph, call_crossing, written, colors, spill_ids);
+            f = replace_and_spill(f, colors, spill_ids, call_crossing);
+        } while (!spill_ids.empty());
+        return f;
+    }
+
+    void shift_frame(const vector<Instruction *> &instructions, int64_t bytes) {
+        for (auto const &inst : instructions) {
+            int offset = frame_offset_index(inst);
+            if (offset != -1 && inst->operands[offset].value >= 0) {
+                inst->operands[offset].value += bytes;
+            }
+        }
+    }
+
+    inline bool falls_through(const Instruction *inst) {
+        return inst->operators[0] != Operator_Type::GOTO && inst->operators[0] != Operator_Type::CJUMP &&
+               inst->operators[0] != Operator_Type::RETURN;
+    }
+
+    vector<int> partition(const Function *f, const vector<vector<int>> &succ, int region_size) {
+        /*
+         * Regions start at labels, preferably outside every loop. A label right after a
+         * call is the return point of that call and never starts a region.
+         * */
+        int n = f->instructions.size();
+        vector<int> depth(n + 1, 0);
+        for (int i = 0; i < n; i++) {
+            for (auto const &s : succ[i]) {
+                if (s <= i) {
+                    depth[s]++;
+                    depth[i + 1]--;
+                }
+            }
+        }
+        for (int i = 1; i <= n; i++) {
+            depth[i] += depth[i - 1];
+        }
+        vector<int> starts = {0};
+        for (int i = 1; i < n; i++) {
+            int size = i - starts.back();
+            if (f->instructions[i]->operators[0] == Operator_Type::LABEL &&
+                    f->instructions[i - 1]->operators[0] != Operator_Type::CALL &&
+                    ((size >= region_size && depth[i] == 0) || size >= 2 * region_size)) {
+                starts.push_back(i);
+            }
+        }
+        return starts;
+    }
+
+    map<int, vector<int32_t>> live_into_entries(const Function *f, const vector<int> &starts,
+                                                const vector<int> &region_of, const set<int> &entries,
+                                                const vector<int> &labels) {
+        /*
+         * Ids live into every entry of a region, without a liveness pass over the whole
+         * function. Each region is analyzed alone, with every edge leaving it ending in a
+         * stub that reads what is currently known to be live at its destination. Regions
+         * are revisited, last to first, until the entries no longer change.
+         * */
+        map<int, vector<int32_t>> live_in;
+        int n = f->instructions.size();
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int r = starts.size() - 1; r >= 0; r--) {
+                int begin = starts[r], end = r + 1 < starts.size() ? starts[r + 1] : n;
+                Function *probe = empty_copy(f);
+                for (int i = begin; i < end; i++) {
+                    probe->instructions.push_back(new Instruction(*f->instructions[i]));
+                }
+                vector<int> exits;
+                if (end < n && falls_through(f->instructions[end - 1])) {
+                    probe->instructions.push_back(new_instruction({Operator_Type::GOTO}, {f->instructions[end]->operands[0]}));
+                }
+                for (int i = begin; i < probe->instructions.size() + begin; i++) {
+                    Instruction *inst = probe->instructions[i - begin];
+                    if (inst->operators[0] == Operator_Type::GOTO) {
+                        exits.push_back(labels[inst->operands[0].id]);
+                    } else if (inst->operators[0] == Operator_Type::CJUMP) {
+                        exits.push_back(labels[inst->operands[inst->operand_count - 2].id]);
+                        exits.push_back(labels[inst->operands[inst->operand_count - 1].id]);
+                    }
+                }
+                set<int> stubs;
+                for (auto target : exits) {
+                    if (region_of[target] == r || !stubs.insert(target).second) {
+                        continue;
+                    }
+                    Operand label = f->instructions[target]->operands[0];
+                    probe->instructions.push_back(new_instruction({Operator_Type::LABEL}, {label}));
+                    for (auto id : live_in[target]) {
+                        Operand o = {id < register_count ? REGISTER : VARIABLE, id, 0};
+                        probe->instructions.push_back(new_instruction({Operator_Type::MOVQ}, {o, o}));
+                    }
+                    probe->instructions.push_back(new_instruction({Operator_Type::GOTO}, {label}));
+                }
+
+                vector<int32_t> old_ids = drop_unused_names(probe);
+                Live_Bits live = live_analysis(probe);
+                for (int i = begin; i < end; i++) {
+                    if (entries.count(i) == 0) {
+                        continue;
+                    }
+                    vector<int32_t> ids;
+                    for (auto id : set_bits(live.in, i - begin, live.words)) {
+                        ids.push_back(old_ids[id]);
+                    }
+                    sort(ids.begin(), ids.end());
+                    if (ids != live_in[i]) {
+                        live_in[i] = ids;
+                        changed = true;
+                    }
+                }
+            }
+        }
+        return live_in;
+    }
+
+    Function *allocate_by_regions(Function *f, int region_size, ostream *log) {
+        /*
+         * Allocates a large function one region at a time so that no interference graph
+         * covers more than a region.
+         *
+         * A value live at a label that can be reached from another region has a home
+         * slot: every edge into such a label stores it there first, and the label reloads
+         * it. Inside a region, names are allocated independently of the other regions.
+         * The copies of the callee-saved registers live through the whole function, so
+         * they go to the stack up front.
+         * */
+        set<int32_t> saves;
+        for (auto const &inst : f->instructions) {
+            for (int j = 0; j < inst->operand_count; j++) {
+                const Operand &opd = inst->operands[j];
+                if (opd.kind == VARIABLE && callee_save_register(f, opd.id) != -1) {
+                    saves.insert(opd.id);
+                }
+            }
+        }
+        for (auto const &save : saves) {
+            f = spill(f, save);
+        }
+
+        int n = f->instructions.size();
+        vector<vector<int>> succ = successors(f);
+        vector<int> starts = partition(f, succ, region_size);
+        if (starts.size() == 1) {
+            return allocate_registers(f);
+        }
+        vector<int> region_of(n);
+        for (int r = 0; r < starts.size(); r++) {
+            int end = r + 1 < starts.size() ? starts[r + 1] : n;
+            for (int i = starts[r]; i < end; i++) {
+                region_of[i] = r;
+            }
+        }
+
+        set<int> entries;
+        for (int i = 0; i < n; i++) {
+            for (auto const &s : succ[i]) {
+                if (region_of[s] != region_of[i]) {
+                    entries.insert(s);
+                }
+            }
+        }
+        vector<int> labels(f->labels.size(), 0);
+        for (int i = 0; i < n; i++) {
+            if (f->instructions[i]->operators[0] == Operator_Type::LABEL) {
+                labels[f->instructions[i]->operands[0].id] = i;
+            }
+        }
+        map<int, vector<int32_t>> live_in = live_into_entries(f, starts, region_of, entries, labels);
+        auto by_name = [f](int32_t a, int32_t b) { return f->names[a].str() < f->names[b].str(); };
+        for (auto &entry : live_in) {
+            sort(entry.second.begin(), entry.second.end(), by_name);
+        }
+        map<int, vector<int32_t>> boundary_values;
+        map<int32_t, int64_t> home;
+        for (auto const &e : entries) {
+            for (auto const &v : live_in[e]) {
+                if (v > rsp_id) {
+                    boundary_values[e].push_back(v);
+                    if (home.count(v) == 0) {
+                        int64_t slot = home.size();
+                        home[v] = slot * 8;
+                    }
+                }
+            }
+        }
+        shift_frame(f->instructions, home.size() * 8);
+        f->locals += home.size();
+
+        vector<vector<Instruction *>> regions(starts.size());
+        for (int i = 0; i < n; i++) {
+            Instruction *inst = f->instructions[i];
+            vector<Instruction *> &code = regions[region_of[i]];
+            vector<Instruction *> stores;
+            set<int32_t> stored;
+            for (auto const &s : succ[i]) {
+                if (entries.count(s) > 0) {
+                    for (auto const &v : boundary_values[s]) {
+                        if (stored.insert(v).second) {
+                            stores.push_back(new_instruction({Operator_Type::MEM, Operator_Type::MOVQ},
+                                                             {make_register(rsp_id), make_number(home[v]),
+                                                              {VARIABLE, v, 0}}));
+                        }
+                    }
+                }
+            }
+            if (falls_through(inst) && inst->operators[0] != Operator_Type::CALL) {
+                code.push_back(inst);
+                if (entries.count(i) > 0) {
+                    for (auto const &v : boundary_values[i]) {
+                        code.push_back(new_instruction({Operator_Type::MOVQ, Operator_Type::MEM},
+                                                       {{VARIABLE, v, 0}, make_register(rsp_id),
+                                                        make_number(home[v])}));
+                    }
+                }
+                code.insert(code.end(), stores.begin(), stores.end());
+            } else {
+                code.insert(code.end(), stores.begin(), stores.end());
+                code.push_back(inst);
+            }
+        }
+
+        for (int r = 0; r < regions.size(); r++) {
+            Function *region = empty_copy(f);
+            region->instructions = regions[r];
+
+            /*
+             * Control leaving the region goes to stubs that only read the registers live
+             * at the destination, so liveness inside the region stays exact.
+             * */
+            set<int32_t> local_labels;
+            for (auto const &inst : regions[r]) {
+                if (inst->operators[0] == Operator_Type::LABEL) {
+                    local_labels.insert(inst->operands[0].id);
+                }
+            }
+            int next = r + 1 < starts.size() ? starts[r + 1] : -1;
+            bool fallthrough = next != -1 && falls_through(regions[r].back());
+            if (fallthrough) {
+                region->instructions.push_back(new_instruction({Operator_Type::GOTO},
+                                                               {f->instructions[next]->operands[0]}));
+            }
+            vector<Operand> exits;
+            for (auto const &inst : region->instructions) {
+                if (inst->operators[0] == Operator_Type::GOTO) {
+                    exits.push_back(inst->operands[0]);
+                } else if (inst->operators[0] == Operator_Type::CJUMP) {
+                    exits.push_back(inst->operands[inst->operand_count - 2]);
+                    exits.push_back(inst->operands[inst->operand_count - 1]);
+                }
+            }
+            int32_t first_stub = -1;
+            for (auto const &label : exits) {
+                if (!local_labels.insert(label.id).second) {
+                    continue;
+                }
+                int target = labels[label.id];
+                if (first_stub == -1) {
+                    first_stub = label.id;
+                }
+                region->instructions.push_back(new_instruction({Operator_Type::LABEL}, {label}));
+                for (auto const &reg : live_in[target]) {
+                    if (reg < rsp_id) {
+                        region->instructions.push_back(new_instruction({Operator_Type::MOVQ},
+                                                                       {make_register(reg), make_register(reg)}));
+                    }
+                }
+                region->instructions.push_back(new_instruction({Operator_Type::GOTO}, {label}));
+            }
+
+            region = allocate_registers(region);
+
+            int64_t grown = region->locals - f->locals;
+            if (grown > 0) {
+                for (int other = 0; other < regions.size(); other++) {
+                    if (other != r) {
+                        shift_frame(regions[other], grown * 8);
+                    }
+                }
+                f->locals = region->locals;
+            }
+            vector<Instruction *> &code = region->instructions;
+            if (first_stub != -1) {
+                int idx = 0;
+                while (code[idx]->operators[0] != Operator_Type::LABEL || code[idx]->operands[0].id != first_stub) {
+                    idx++;
+                }
+                code.resize(idx);
+            }
+            if (fallthrough) {
+                code.pop_back();
+            }
+            regions[r] = code;
+        }
+
+        f->instructions.clear();
+        for (auto const &code : regions) {
+            f->instructions.insert(f->instructions.end(), code.begin(), code.end());
+        }
+        if (log != NULL) {
+            *log << f->name << ": " << regions.size() << " regions, " << home.size() << " values cross them" << endl;
+        }
+        return f;
+    }
+}
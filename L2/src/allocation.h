@@ -0,0 +1,13 @@
+#pragma once
+
+#include <ostream>
+
+#include "L2.h"
+
+using namespace std;
+
+namespace L2 {
+    Function *allocate_registers(Function *f);
+
+    Function *allocate_by_regions(Function *f, int region_size, ostream *log);
+}
@@ -0,0 +1,396 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <stack>
+#include <algorithm>
+
+#include "L2.h"
+#include "liveness.h"
+
+using namespace std;
+
+namespace L2 {
+    const vector<string> callee_saved_registers = {"r12", "r13", "r14", "r15", "rbp", "rbx"};
+
+    const string save_prefix = "_callee_save_";
+
+    int32_t callee_save_register(const Function *f, int32_t id) {
+        const string &var = f->names[id];
+        if (var.compare(0, save_prefix.size(), save_prefix) == 0) {
+            for (auto const &reg : callee_saved_registers) {
+                if (var.compare(save_prefix.size(), string::npos, reg) == 0) {
+                    return register_id(reg);
+                }
+            }
+        }
+        return -1;
+    }
+
+    void insert_callee_saves(Function *f) {
+        /*
+         * Copy every callee-saved register into a fresh variable at the entry and copy it
+         * back right before each return. This way the callee-saved registers are no longer
+         * live through the whole function, and the allocator can decide to spill the copies
+         * to give the registers to other variables.
+         * */
+        vector<Instruction *> instructions;
+        vector<Operand> copies;
+        for (auto const &reg : callee_saved_registers) {
+            copies.push_back(new_variable(f, save_prefix + reg));
+            instructions.push_back(new_instruction({Operator_Type::MOVQ}, {copies.back(), make_register(register_id(reg))}));
+            instructions.back()->mark = SAVE_MARK;
+        }
+        for (auto const &inst : f->instructions) {
+            if (inst->operators[0] == Operator_Type::RETURN) {
+                for (int r = 0; r < callee_saved_registers.size(); r++) {
+                    instructions.push_back(new_instruction({Operator_Type::MOVQ},
+                                                           {make_register(register_id(callee_saved_registers[r])), copies[r]}));
+                    instructions.back()->mark = RESTORE_MARK;
+                }
+            }
+            instructions.push_back(inst);
+        }
+        f->instructions = instructions;
+    }
+
+    inline bool is_self_move(const Instruction *inst, const Operand &reg) {
+        return inst->operator_count == 1 && inst->operators[0] == Operator_Type::MOVQ &&
+               inst->operands[0] == reg && inst->operands[1] == reg;
+    }
+
+    inline bool is_save_store(const Instruction *inst, const Operand &reg) {
+        return inst->operator_count == 2 && inst->operators[0] == Operator_Type::MEM &&
+               inst->operators[1] == Operator_Type::MOVQ && inst->operands[0] == make_register(rsp_id) &&
+               inst->operands[2] == reg;
+    }
+
+    inline bool is_restore_load(const Instruction *inst, const Operand &reg, const Operand &offset) {
+        return inst->operator_count == 2 && inst->operators[0] == Operator_Type::MOVQ &&
+               inst->operators[1] == Operator_Type::MEM && inst->operands[0] == reg &&
+               inst->operands[1] == make_register(rsp_id) && inst->operands[2] == offset;
+    }
+
+    vector<vector<int>> successors(const Function *f) {
+        int n = f->instructions.size();
+        vector<int> labels(f->labels.size(), 0);
+        for (int i = 0; i < n; i++) {
+            if (f->instructions[i]->operators[0] == Operator_Type::LABEL) {
+                labels[f->instructions[i]->operands[0].id] = i;
+            }
+        }
+        vector<vector<int>> succ(n);
+        for (int i = 0; i < n; i++) {
+            Instruction *inst = f->instructions[i];
+            switch (inst->operators[0]) {
+                case Operator_Type::CJUMP:
+                    succ[i].push_back(labels[inst->operands[inst->operand_count - 2].id]);
+                    succ[i].push_back(labels[inst->operands[inst->operand_count - 1].id]);
+                    break;
+                case Operator_Type::GOTO:
+                    succ[i].push_back(labels[inst->operands[0].id]);
+                    break;
+                case Operator_Type::RETURN:
+                    break;
+                default:
+                    if (i < n - 1) {
+                        succ[i].push_back(i + 1);
+                    }
+                    break;
+            }
+        }
+        return succ;
+    }
+
+    vector<int> immediate_dominators(const vector<vector<int>> &succ) {
+        /*
+         * Cooper, Harvey and Kennedy's iterative algorithm over the reverse postorder.
+         * Unreachable instructions get -1.
+         * */
+        int n = succ.size();
+        vector<int> order, rpo_num(n, -1), idom(n, -1);
+        vector<vector<int>> pred(n);
+        vector<bool> visited(n, false);
+        stack<pair<int, int>> st;
+        st.push(make_pair(0, 0));
+        visited[0] = true;
+        while (!st.empty()) {
+            int node = st.top().first, &next = st.top().second;
+            if (next < succ[node].size()) {
+                int s = succ[node][next++];
+                if (!visited[s]) {
+                    visited[s] = true;
+                    st.push(make_pair(s, 0));
+                }
+            } else {
+                order.push_back(node);
+                st.pop();
+            }
+        }
+        reverse(order.begin(), order.end());
+        for (int i = 0; i < order.size(); i++) {
+            rpo_num[order[i]] = i;
+        }
+        for (int i = 0; i < n; i++) {
+            for (auto const &s : succ[i]) {
+                pred[s].push_back(i);
+            }
+        }
+        idom[0] = 0;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = 1; i < order.size(); i++) {
+                int node = order[i], new_idom = -1;
+                for (auto p : pred[node]) {
+                    if (idom[p] == -1) {
+                        continue;
+                    }
+                    if (new_idom == -1) {
+                        new_idom = p;
+                        continue;
+                    }
+                    int a = p, b = new_idom;
+                    while (a != b) {
+                        while (rpo_num[a] > rpo_num[b]) {
+                            a = idom[a];
+                        }
+                        while (rpo_num[b] > rpo_num[a]) {
+                            b = idom[b];
+                        }
+                    }
+                    new_idom = a;
+                }
+                if (new_idom != idom[node]) {
+                    idom[node] = new_idom;
+                    changed = true;
+                }
+            }
+        }
+        return idom;
+    }
+
+    bool dominates(const vector<int> &idom, int a, int b) {
+        while (b != a && b != 0) {
+            b = idom[b];
+        }
+        return b == a;
+    }
+
+    int common_dominator(const vector<int> &idom, int a, int b) {
+        set<int> ancestors;
+        for (int node = a; ; node = idom[node]) {
+            ancestors.insert(node);
+            if (node == 0) {
+                break;
+            }
+        }
+        while (ancestors.count(b) == 0) {
+            b = idom[b];
+        }
+        return b;
+    }
+
+    vector<bool> reachable_from(const vector<vector<int>> &succ, const vector<int> &roots) {
+        vector<bool> reached(succ.size(), false);
+        stack<int> st;
+        for (auto r : roots) {
+            st.push(r);
+        }
+        while (!st.empty()) {
+            int node = st.top();
+            st.pop();
+            if (reached[node]) {
+                continue;
+            }
+            reached[node] = true;
+            for (auto s : succ[node]) {
+                st.push(s);
+            }
+        }
+        return reached;
+    }
+
+    vector<bool> in_cycle(const vector<vector<int>> &succ) {
+        /*
+         * Kosaraju's algorithm: an instruction is part of a cycle if its strongly connected
+         * component has more than one instruction, or if it jumps to itself.
+         * */
+        int n = succ.size();
+        vector<int> order, component(n, -1), component_size;
+        vector<vector<int>> pred(n);
+        vector<bool> visited(n, false), cycle(n, false);
+        for (int i = 0; i < n; i++) {
+            for (auto s : succ[i]) {
+                pred[s].push_back(i);
+            }
+        }
+        for (int root = 0; root < n; root++) {
+            if (visited[root]) {
+                continue;
+            }
+            stack<pair<int, int>> st;
+            st.push(make_pair(root, 0));
+            visited[root] = true;
+            while (!st.empty()) {
+                int node = st.top().first, &next = st.top().second;
+                if (next < succ[node].size()) {
+                    int s = succ[node][next++];
+                    if (!visited[s]) {
+                        visited[s] = true;
+                        st.push(make_pair(s, 0));
+                    }
+                } else {
+                    order.push_back(node);
+                    st.pop();
+                }
+            }
+        }
+        for (int i = n - 1; i >= 0; i--) {
+            if (component[order[i]] != -1) {
+                continue;
+            }
+            int id = component_size.size();
+            component_size.push_back(0);
+            stack<int> st;
+            st.push(order[i]);
+            component[order[i]] = id;
+            while (!st.empty()) {
+                int node = st.top();
+                st.pop();
+                component_size[id]++;
+                for (auto p : pred[node]) {
+                    if (component[p] == -1) {
+                        component[p] = id;
+                        st.push(p);
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            cycle[i] = component_size[component[i]] > 1 || find(succ[i].begin(), succ[i].end(), i) != succ[i].end();
+        }
+        return cycle;
+    }
+
+    inline Operand saved_register(const Instruction *inst) {
+        /*
+         * The register a marked copy saves or restores, whether it ended up as a self move,
+         * a store or a load.
+         * */
+        return inst->mark == SAVE_MARK && inst->operators[0] == Operator_Type::MEM ? inst->operands[2] : inst->operands[0];
+    }
+
+    void shrink_wrap_callee_saves(Function *f) {
+        /*
+         * After allocation every copy made by insert_callee_saves is either a self move,
+         * or a store of the register at the entry plus a load before every return. Both
+         * are found through their marks. Self moves are dropped. A register that is never
+         * written is not saved at all, otherwise its store is sunk to the closest point
+         * that dominates all the writes, is not part of a loop and dominates every return
+         * it can reach. Only the returns reachable from there restore the register.
+         * */
+        int n = f->instructions.size();
+        map<int32_t, int> saves;
+        map<int32_t, vector<int>> restores;
+        for (int i = 0; i < n; i++) {
+            Instruction *inst = f->instructions[i];
+            if (inst->mark == SAVE_MARK) {
+                saves[saved_register(inst).id] = i;
+            } else if (inst->mark == RESTORE_MARK) {
+                restores[saved_register(inst).id].push_back(i);
+            }
+        }
+
+        Live_Bits live;
+        live.words = 0;
+        vector<vector<int>> succ;
+        vector<int> idom;
+        vector<bool> cycle, removed(n, false);
+        map<int, vector<Instruction *>> insert_before, insert_after;
+        for (auto const &entry : saves) {
+            Operand reg = make_register(entry.first);
+            Instruction *save = f->instructions[entry.second];
+            const vector<int> &loads = restores[reg.id];
+            bool self_moves = is_self_move(save, reg), stores = is_save_store(save, reg);
+            for (auto r : loads) {
+                self_moves = self_moves && is_self_move(f->instructions[r], reg);
+                stores = stores && is_restore_load(f->instructions[r], reg, save->operands[1]);
+            }
+            if (self_moves) {
+                removed[entry.second] = true;
+                for (auto r : loads) {
+                    removed[r] = true;
+                }
+                continue;
+            } else if (!stores) {
+                continue;
+            }
+
+            if (live.words == 0) {
+                live = live_analysis(f);
+                succ = successors(f);
+                idom = immediate_dominators(succ);
+                cycle = in_cycle(succ);
+            }
+            int wrap = -1;
+            for (int i = 0; i < n; i++) {
+                if (f->instructions[i]->mark == NO_MARK && idom[i] != -1 && live.test(live.kill, i, reg.id)) {
+                    wrap = wrap == -1 ? i : common_dominator(idom, wrap, i);
+                }
+            }
+            if (wrap == -1) {
+                removed[entry.second] = true;
+                for (auto r : loads) {
+                    removed[r] = true;
+                }
+                continue;
+            }
+            /*
+             * Climbing back into the saves at the entry means there is nothing to gain.
+             * */
+            vector<bool> reached;
+            while (wrap != 0 && f->instructions[wrap]->mark != SAVE_MARK) {
+                if (!cycle[wrap]) {
+                    bool dominated = true;
+                    reached = reachable_from(succ, {wrap});
+                    for (auto r : loads) {
+                        if (reached[r] && !dominates(idom, wrap, r)) {
+                            dominated = false;
+                        }
+                    }
+                    if (dominated) {
+                        break;
+                    }
+                }
+                wrap = idom[wrap];
+            }
+            if (wrap == 0 || f->instructions[wrap]->mark == SAVE_MARK) {
+                continue;
+            }
+
+            removed[entry.second] = true;
+            Instruction *moved = new Instruction(*save);
+            if (f->instructions[wrap]->operators[0] == Operator_Type::LABEL) {
+                insert_after[wrap].push_back(moved);
+            } else {
+                insert_before[wrap].push_back(moved);
+            }
+            for (auto r : loads) {
+                if (!reached[r]) {
+                    removed[r] = true;
+                }
+            }
+        }
+
+        vector<Instruction *> instructions;
+        for (int i = 0; i < n; i++) {
+            instructions.insert(instructions.end(), insert_before[i].begin(), insert_before[i].end());
+            if (!removed[i]) {
+                instructions.push_back(f->instructions[i]);
+            }
+            instructions.insert(instructions.end(), insert_after[i].begin(), insert_after[i].end());
+        }
+        f->instructions = instructions;
+    }
+}
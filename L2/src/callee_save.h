@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "L2.h"
+
+using namespace std;
+
+namespace L2 {
+    vector<vector<int>> successors(const Function *f);
+
+    /*
+     * The register id a copy made by insert_callee_saves stands for, -1 for any other id.
+     * */
+    int32_t callee_save_register(const Function *f, int32_t id);
+
+    void insert_callee_saves(Function *f);
+
+    void shrink_wrap_callee_saves(Function *f);
+}
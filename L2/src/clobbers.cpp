@@ -0,0 +1,156 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <mutex>
+
+#include "L2.h"
+#include "liveness.h"
+
+using namespace std;
+
+namespace L2 {
+    const vector<string> caller_saved_registers = {"r10", "r11", "r8", "r9", "rax", "rcx", "rdi", "rdx", "rsi"};
+
+    uint32_t register_mask(const vector<string> &registers) {
+        uint32_t mask = 0;
+        for (auto const &reg : registers) {
+            mask |= (uint32_t)1 << register_id(reg);
+        }
+        return mask;
+    }
+
+    const uint32_t caller_saved_mask = register_mask(caller_saved_registers);
+
+    map<string, uint32_t> clobbers;
+
+    /*
+     * Functions in different components of the call graph are allocated concurrently.
+     * */
+    mutex clobbers_mutex;
+
+    uint32_t call_clobbers(const string &callee) {
+        /*
+         * Functions that are not allocated yet, the runtime and indirect calls may write any
+         * caller-saved register.
+         * */
+        lock_guard<mutex> lock(clobbers_mutex);
+        auto it = clobbers.find(callee);
+        return it == clobbers.end() ? caller_saved_mask : it->second;
+    }
+
+    uint32_t written_registers(const Function *f) {
+        /*
+         * The caller-saved registers the instructions of f kill, calls included. array-error
+         * never returns, so what it writes can never be seen by the caller.
+         * */
+        Live_Bits live = live_analysis(f);
+        uint32_t regs = 0;
+        for (int i = 0; i < f->instructions.size(); i++) {
+            Instruction *inst = f->instructions[i];
+            if (inst->operators[0] == Operator_Type::CALL && inst->operands[0].kind == RUNTIME_FUNCTION &&
+                    f->labels[inst->operands[0].id] == "array-error") {
+                continue;
+            }
+            for (int32_t id = 0; id < rsp_id; id++) {
+                if (live.test(live.kill, i, id)) {
+                    regs |= (uint32_t)1 << id;
+                }
+            }
+        }
+        return regs & caller_saved_mask;
+    }
+
+    void record_clobbers(Function *f) {
+        /*
+         * Once f is allocated, the registers it writes are the ones a call to it can write.
+         * */
+        uint32_t regs = written_registers(f);
+        lock_guard<mutex> lock(clobbers_mutex);
+        clobbers[f->name] = regs;
+    }
+
+    struct call_graph {
+        vector<vector<int>> callees;
+        vector<int> index, low;
+        vector<bool> on_stack;
+        vector<int> stack;
+        vector<int> component;
+        vector<vector<int>> components;
+        int counter = 0;
+    };
+
+    void strong_connect(const Program &p, call_graph &g, int v) {
+        g.index[v] = g.low[v] = g.counter++;
+        g.stack.push_back(v);
+        g.on_stack[v] = true;
+        for (int w : g.callees[v]) {
+            if (g.index[w] == -1) {
+                strong_connect(p, g, w);
+                g.low[v] = min(g.low[v], g.low[w]);
+            } else if (g.on_stack[w]) {
+                g.low[v] = min(g.low[v], g.index[w]);
+            }
+        }
+        if (g.low[v] == g.index[v]) {
+            vector<int> members;
+            int w;
+            do {
+                w = g.stack.back();
+                g.stack.pop_back();
+                g.on_stack[w] = false;
+                g.component[w] = g.components.size();
+                members.push_back(w);
+            } while (w != v);
+            g.components.push_back(members);
+        }
+    }
+
+    vector<vector<int>> call_graph_components(const Program &p, vector<vector<int>> &callee_components) {
+        /*
+         * Tarjan's algorithm emits every strongly connected component of the call graph after
+         * all the components it calls into. Calls inside a recursive component see a callee
+         * that is not recorded yet and fall back to the full caller-saved set.
+         * */
+        int n = p.functions.size();
+        map<string, int> ids;
+        for (int i = 0; i < n; i++) {
+            ids[p.functions[i]->name] = i;
+        }
+        call_graph g;
+        g.callees.resize(n);
+        g.index.assign(n, -1);
+        g.low.assign(n, 0);
+        g.on_stack.assign(n, false);
+        g.component.assign(n, -1);
+        for (int i = 0; i < n; i++) {
+            for (auto const &inst : p.functions[i]->instructions) {
+                if (inst->operators[0] == Operator_Type::CALL && inst->operands[0].kind == LABEL_NAME) {
+                    auto it = ids.find(p.functions[i]->labels[inst->operands[0].id]);
+                    if (it != ids.end()) {
+                        g.callees[i].push_back(it->second);
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            if (g.index[i] == -1) {
+                strong_connect(p, g, i);
+            }
+        }
+        callee_components.assign(g.components.size(), vector<int>());
+        for (int c = 0; c < g.components.size(); c++) {
+            set<int> callees;
+            for (int v : g.components[c]) {
+                for (int w : g.callees[v]) {
+                    if (g.component[w] != c) {
+                        callees.insert(g.component[w]);
+                    }
+                }
+            }
+            callee_components[c].assign(callees.begin(), callees.end());
+        }
+        return g.components;
+    }
+}
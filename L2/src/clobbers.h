@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "L2.h"
+
+using namespace std;
+
+namespace L2 {
+    /*
+     * Registers a call to callee may write, bit i stands for register id i.
+     * */
+    uint32_t call_clobbers(const string &callee);
+
+    uint32_t written_registers(const Function *f);
+
+    void record_clobbers(Function *f);
+
+    vector<vector<int>> call_graph_components(const Program &p, vector<vector<int>> &callee_components);
+}
@@ -1,11 +1,13 @@
 #include <string>
-#include <map>
-#include <set>
 #include <utility>
 #include <vector>
 #include <stack>
 #include <algorithm>
 
+#include "coloring.h"
+#include "callee_save.h"
+#include "spill.h"
+
 using namespace std;
 
 namespace L2 {
@@ -15,68 +17,140 @@ namespace L2 {
     const vector<string> ordered_registers = {"r10", "r11", "r8", "r9", "rax", "rcx", "rdi", "rdx",
                                               "rsi", "r12", "r13", "r14", "r15", "rbp", "rbx"};
 
-    const set<string> registers(ordered_registers.begin(), ordered_registers.end());
+    vector<int32_t> register_ids(const vector<string> &registers) {
+        vector<int32_t> ids;
+        for (auto const &reg : registers) {
+            ids.push_back(register_id(reg));
+        }
+        return ids;
+    }
+
+    const vector<int32_t> ordered_register_ids = register_ids(ordered_registers);
+
+    const vector<int32_t> callee_saved_first_register_ids = register_ids(
+            {"r12", "r13", "r14", "r15", "rbp", "rbx", "r10", "r11", "r8", "r9", "rax", "rcx", "rdi", "rdx", "rsi"});
 
-    inline bool is_register(const string &s) {
-        return s == "rsp" || registers.find(s) != registers.end();
+    inline bool is_register(int32_t id) {
+        return id < register_count;
     }
 
-    void rebuild_graph(const map<string, set<string>> &graph, map<string, string> &reg_map,
-                       stack<string> &variable_stack, set<string> &spill) {
-        set<string> adjacent_colors;
-        string node;
+    void rebuild_graph(const Function *f, const Interference_Graph &graph, const vector<bool> &call_crossing,
+                       uint32_t written, vector<int32_t> &colors, stack<int32_t> &variable_stack,
+                       vector<int32_t> &spill) {
         while (!variable_stack.empty()) {
-            node = variable_stack.top();
+            int32_t node = variable_stack.top();
             variable_stack.pop();
-            if (!is_register(node)) {
-                adjacent_colors.clear();
-                for (auto const &entry : graph.at(node)) {
-                    if (is_register(entry)) {
-                        adjacent_colors.insert(entry);
-                    } else {
-                        if (reg_map.find(entry) != reg_map.end()) {
-                            adjacent_colors.insert(reg_map[entry]);
-                        }
+            if (is_register(node)) {
+                continue;
+            }
+            int32_t saved_reg = callee_save_register(f, node);
+            uint32_t adjacent_colors = 0;
+            for (auto const &entry : graph.adjacent[node]) {
+                if (is_register(entry)) {
+                    /*
+                     * rsp is never handed out, it must not use up one of the k colors.
+                     * */
+                    if (entry != rsp_id) {
+                        adjacent_colors |= (uint32_t)1 << entry;
                     }
+                } else if (colors[entry] != -1) {
+                    adjacent_colors |= (uint32_t)1 << colors[entry];
                 }
-                if (adjacent_colors.size() < k) {
-                    for (auto const &reg : ordered_registers) {
-                        if (adjacent_colors.find(reg) == adjacent_colors.end()) {
-                            reg_map[node] = reg;
+            }
+            if (saved_reg != -1) {
+                /*
+                 * The copy of a callee-saved register either stays in that register, which
+                 * makes the save and the restore free, or it goes to memory.
+                 * */
+                if (((adjacent_colors >> saved_reg) & 1) == 0) {
+                    colors[node] = saved_reg;
+                } else {
+                    spill.push_back(node);
+                }
+            } else if (__builtin_popcount(adjacent_colors) < k) {
+                /*
+                 * Variables living across a call prefer callee-saved registers, the others
+                 * prefer caller-saved ones so that callee-saved registers stay free for them.
+                 * A register f writes anyway and the crossed callees leave alone costs neither
+                 * a save nor a wider clobber set for the callers of f, so it is taken first.
+                 * */
+                uint32_t free_written = written & ~adjacent_colors;
+                if (call_crossing[node] && free_written != 0) {
+                    colors[node] = __builtin_ctz(free_written);
+                } else {
+                    const vector<int32_t> &preferred = call_crossing[node] ? callee_saved_first_register_ids
+                                                                           : ordered_register_ids;
+                    for (auto const &reg : preferred) {
+                        if (((adjacent_colors >> reg) & 1) == 0) {
+                            colors[node] = reg;
                             break;
                         }
                     }
-                } else {
-                    spill.insert(node);
                 }
+                written |= (uint32_t)1 << colors[node];
+            } else {
+                spill.push_back(node);
             }
         }
     }
 
-    struct cmp {
-        bool operator() (const pair<string, set<string>> &left, const pair<string, set<string>> &right) {
-            return left.second.size() < right.second.size();
+    void graph_coloring(const Function *f, const Interference_Graph &graph, const vector<bool> &call_crossing,
+                        uint32_t written, vector<int32_t> &colors, vector<int32_t> &spill) {
+        /*
+         * Nodes are visited in the order of their names, so the result does not depend on
+         * how ids were handed out.
+         * */
+        auto by_name = [f](int32_t a, int32_t b) { return f->names[a].str() < f->names[b].str(); };
+        vector<int32_t> ordered_graph;
+        for (int32_t id = 0; id < graph.node.size(); id++) {
+            if (graph.node[id]) {
+                ordered_graph.push_back(id);
+            }
         }
-    };
-
-    void graph_coloring(const map<string, set<string>> &graph, map<string, string> &reg_map, set<string> &spill) {
-        vector<pair<string, set<string>>> ordered_graph;
-        stack<string> variable_stack;
-        for (auto const &entry : graph) {
-            ordered_graph.push_back(make_pair(entry.first, entry.second));
+        sort(ordered_graph.begin(), ordered_graph.end(), by_name);
+        sort(ordered_graph.begin(), ordered_graph.end(), [&graph](int32_t a, int32_t b) {
+            return graph.adjacent[a].size() < graph.adjacent[b].size();
+        });
+        colors.assign(f->names.size(), -1);
+        for (int32_t reg = 0; reg < register_count; reg++) {
+            colors[reg] = reg;
         }
-        sort(ordered_graph.begin(), ordered_graph.end(), cmp());
+        stack<int32_t> variable_stack;
         int index = 0;
-        while (index < ordered_graph.size() && ordered_graph[index].second.size() < k) {
+        while (index < ordered_graph.size() && graph.adjacent[ordered_graph[index]].size() < k) {
             index++;
         }
         for (int i = index - 1; i >= 0; i--) {
-            variable_stack.push(ordered_graph[i].first);
+            variable_stack.push(ordered_graph[i]);
+        }
+        /*
+         * Copies of callee-saved registers only cost a store at the entry and a load at
+         * the returns, so they are colored last and are the first to give up their register.
+         * */
+        for (int i = ordered_graph.size() - 1; i >= index; i--) {
+            if (callee_save_register(f, ordered_graph[i]) != -1) {
+                variable_stack.push(ordered_graph[i]);
+            }
         }
         for (int i = ordered_graph.size() - 1; i >= index; i--) {
-            variable_stack.push(ordered_graph[i].first);
+            if (callee_save_register(f, ordered_graph[i]) == -1 &&
+                    !is_spill_temporary(f->names[ordered_graph[i]])) {
+                variable_stack.push(ordered_graph[i]);
+            }
+        }
+        /*
+         * Temporaries introduced by the spiller live for a single instruction, spilling them
+         * again frees nothing, and the allocator would never terminate if one of them has to
+         * take a fixed register such as rcx. They are colored first.
+         * */
+        for (int i = ordered_graph.size() - 1; i >= index; i--) {
+            if (callee_save_register(f, ordered_graph[i]) == -1 &&
+                    is_spill_temporary(f->names[ordered_graph[i]])) {
+                variable_stack.push(ordered_graph[i]);
+            }
         }
 
-        rebuild_graph(graph, reg_map, variable_stack, spill);
+        rebuild_graph(f, graph, call_crossing, written, colors, variable_stack, spill);
+        sort(spill.begin(), spill.end(), by_name);
     }
 }
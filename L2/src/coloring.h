@@ -1,11 +1,19 @@
 #pragma once
 
-#include <string>
-#include <map>
-#include <set>
+#include <vector>
+#include <cstdint>
+
+#include "L2.h"
+#include "interference.h"
 
 using namespace std;
 
 namespace L2 {
-    void graph_coloring(const map<string, set<string>> &graph, map<string, string> &reg_map, set<string> &spill);
-}
\ No newline at end of file
+    /*
+     * colors maps every register and variable id to the register id it is given, or -1.
+     * The variables that do not get one are added to spill in the order of their names.
+     * written holds the caller-saved registers f already writes, see written_registers.
+     * */
+    void graph_coloring(const Function *f, const Interference_Graph &graph, const vector<bool> &call_crossing,
+                        uint32_t written, vector<int32_t> &colors, vector<int32_t> &spill);
+}
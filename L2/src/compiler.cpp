@@ -6,79 +6,128 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
 
 #include "parser.h"
+#include "liveness.h"
 #include "interference.h"
 #include "coloring.h"
 #include "spill.h"
+#include "callee_save.h"
+#include "slot_coloring.h"
+#include "webs.h"
+#include "optimize.h"
+#include "schedule.h"
+#include "allocation.h"
+#include "clobbers.h"
+#include "parallel.h"
 
 using namespace std;
 using namespace L2;
 
 
-ostream &operator<<(ostream &os, const Instruction &inst) {
+string operand_string(const Function *f, const Operand &o) {
+    return o.kind == NUMBER ? to_string(o.value) : operand_name(f, o).str();
+}
+
+string get_cmp_string(const Function *f, const Instruction &inst, int first) {
+    /*
+     * Comparison starting at operands[first], either side of which can be a memory operand.
+     * */
+    auto opd = [&](int j) { return operand_string(f, inst.operands[j]); };
+    string left, right, op;
+    int mem = mem_operand_index(&inst);
+    op = cmp_operator(&inst) == Operator_Type::LQ ? " < " :
+         (cmp_operator(&inst) == Operator_Type::LEQ ? " <= " : " = ");
+    if (mem == first) {
+        left = "(mem " + opd(first) + ' ' + opd(first + 1) + ')';
+        right = opd(first + 2);
+    } else {
+        left = opd(first);
+        right = mem == -1 ? opd(first + 1)
+                          : "(mem " + opd(first + 1) + ' ' + opd(first + 2) + ')';
+    }
+    return left + op + right;
+}
+
+ostream &print_instruction(ostream &os, const Function *f, const Instruction &inst) {
+    auto opd = [&](int j) { return operand_string(f, inst.operands[j]); };
     string op;
-    switch (inst.operators.front()) {
+    switch (inst.operators[0]) {
         case Operator_Type::MOVQ:
-            if (inst.operators.size() == 1) {
-                os << '(' << inst.operands[0] << " <- " << inst.operands[1] << ')';
-            } else if (inst.operators[1] == Operator_Type::MEM) {
-                os << '(' << inst.operands[0] << " <- (mem " << inst.operands[1] << ' ' << inst.operands[2] << "))";
+            if (inst.operator_count == 1) {
+                os << '(' << opd(0) << " <- " << opd(1) << ')';
+            } else if (inst.operator_count == 2 && inst.operators[1] == Operator_Type::MEM) {
+                os << '(' << opd(0) << " <- (mem " << opd(1) << ' ' << opd(2) << "))";
+            } else if (inst.operators[1] == Operator_Type::MEM_INDEX) {
+                os << '(' << opd(0) << " <- (mem " << opd(1) << ' ' << opd(2) << ' '
+                   << opd(3) << ' ' << opd(4) << "))";
             } else if (inst.operators[1] == Operator_Type::STACK_ARG) {
-                os << '(' << inst.operands[0] << " <- (stack-arg " << inst.operands[1] << "))";
+                os << '(' << opd(0) << " <- (stack-arg " << opd(1) << "))";
             } else {
-                op = inst.operators[1] == Operator_Type::LQ ? " < " :
-                     (inst.operators[1] == Operator_Type::LEQ ? " <= " : " = ");
-                os << '(' << inst.operands[0] << " <- " << inst.operands[1] << op << inst.operands[2] << ")";
+                os << '(' << opd(0) << " <- " << get_cmp_string(f, inst, 1) << ")";
             }
             break;
         case Operator_Type::ADDQ:
         case Operator_Type::SUBQ:
-            op = inst.operators[0] == Operator_Type::ADDQ ? " += " : " -= ";
-            if (inst.operators.size() == 1) {
-                os << '(' << inst.operands[0] << op << inst.operands[1] << ')';
-            } else {
-                os << '(' << inst.operands[0] << op << "(mem " << inst.operands[1] << ' ' << inst.operands[2] << "))";
-            }
-            break;
         case Operator_Type::IMULQ:
         case Operator_Type::ANDQ:
         case Operator_Type::SALQ:
         case Operator_Type::SARQ:
-            op = inst.operators[0] == Operator_Type::IMULQ ? " *= " :
-                 (inst.operators[0] == Operator_Type::ANDQ ? " &= " :
-                  (inst.operators[0] == Operator_Type::SALQ ? " <<= " : " >>= "));
-            os << '(' << inst.operands[0] << op << inst.operands[1] << ')';
+            op = inst.operators[0] == Operator_Type::ADDQ ? " += " :
+                 (inst.operators[0] == Operator_Type::SUBQ ? " -= " :
+                  (inst.operators[0] == Operator_Type::IMULQ ? " *= " :
+                   (inst.operators[0] == Operator_Type::ANDQ ? " &= " :
+                    (inst.operators[0] == Operator_Type::SALQ ? " <<= " : " >>= "))));
+            if (inst.operator_count == 1) {
+                os << '(' << opd(0) << op << opd(1) << ')';
+            } else {
+                os << '(' << opd(0) << op << "(mem " << opd(1) << ' ' << opd(2) << "))";
+            }
             break;
         case Operator_Type::CJUMP:
-            op = inst.operators[1] == Operator_Type::LQ ? " < " :
-                 (inst.operators[1] == Operator_Type::LEQ ? " <= " : " = ");
-            os << "(cjump " << inst.operands[0] << op << inst.operands[1] << ' ' << inst.operands[2] << ' ' << inst.operands[3] << ')';
+            os << "(cjump " << get_cmp_string(f, inst, 0) << ' ' << opd(inst.operand_count - 2) << ' '
+               << opd(inst.operand_count - 1) << ')';
             break;
         case Operator_Type::LABEL:
-            os << inst.operands[0];
+            os << opd(0);
             break;
         case Operator_Type::GOTO:
-            os << "(goto " << inst.operands[0] << ')';
+            os << "(goto " << opd(0) << ')';
             break;
         case Operator_Type::RETURN:
             os << "(return)";
             break;
         case Operator_Type::CALL:
-            os << "(call " << inst.operands[0] << ' ' << inst.operands[1] << ')';
+            os << "(call " << opd(0) << ' ' << opd(1) << ')';
             break;
         case Operator_Type::CISC:
-            os << '(' << inst.operands[0] << " @ " << inst.operands[1] << ' ' << inst.operands[2] << ' ' << inst.operands[3] << ')';
+            os << '(' << opd(0) << " @ " << opd(1) << ' ' << opd(2) << ' ' << opd(3) << ')';
             break;
         case Operator_Type::MEM:
             op = inst.operators[1] == Operator_Type::MOVQ ? " <- " :
-                 (inst.operators[1] == Operator_Type::ADDQ ? " += " : " -= ");
-            os << "((mem " << inst.operands[0] << ' ' << inst.operands[1] << ')' << op << inst.operands[2] << ')';
+                 (inst.operators[1] == Operator_Type::ADDQ ? " += " :
+                  (inst.operators[1] == Operator_Type::SUBQ ? " -= " :
+                   (inst.operators[1] == Operator_Type::ANDQ ? " &= " :
+                    (inst.operators[1] == Operator_Type::SALQ ? " <<= " :
+                     (inst.operators[1] == Operator_Type::SARQ ? " >>= " :
+                      (inst.operators[1] == Operator_Type::INC ? "++" : "--"))))));
+            os << "((mem " << opd(0) << ' ' << opd(1) << ')' << op;
+            if (inst.operand_count > 2) {
+                os << opd(2);
+            }
+            os << ')';
+            break;
+        case Operator_Type::MEM_INDEX:
+            os << "((mem " << opd(0) << ' ' << opd(1) << ' ' << opd(2) << ' '
+               << opd(3) << ") <- " << opd(4) << ')';
             break;
         case Operator_Type::INC:
         case Operator_Type::DEC:
             op = inst.operators[0] == Operator_Type::INC ? "++" : "--";
-            os << "(" << inst.operands[0] << op << ')';
+            os << "(" << opd(0) << op << ')';
             break;
         default:
             cerr << "\tERROR L2" << endl;
@@ -93,7 +142,7 @@ ostream &operator<<(ostream &os, const Program &p) {
         os << "    (" << f->name << endl
            << "    " << f->arguments << ' ' << f->locals << endl;
         for (auto const &inst : f->instructions) {
-            os << "        " << *inst << endl;
+            print_instruction(os << "        ", f, *inst) << endl;
         }
         os << "    )" << endl;
     }
@@ -103,13 +152,18 @@ ostream &operator<<(ostream &os, const Program &p) {
 
 
 
-void remove_stack_arg(Program &p) {
+void remove_stack_arg(Program &p, bool native_calls) {
+    /*
+     * With real call instructions the return address sits between the frame and the stack
+     * arguments, otherwise it is above them.
+     * */
     for (auto const &f : p.functions) {
         for (auto const &inst : f->instructions) {
-            if (inst->operators.size() == 2 && inst->operators[1] == Operator_Type::STACK_ARG) {
+            if (inst->operator_count == 2 && inst->operators[1] == Operator_Type::STACK_ARG) {
                 inst->operators[1] = Operator_Type::MEM;
-                inst->operands.push_back(to_string(stoll(inst->operands[1]) + f->locals * 8));
-                inst->operands[1] = "rsp";
+                inst->operands[inst->operand_count++] = make_number(inst->operands[1].value + f->locals * 8 +
+                                                                    (native_calls ? 8 : 0));
+                inst->operands[1] = make_register(rsp_id);
             }
         }
     }
@@ -118,20 +172,28 @@ void remove_stack_arg(Program &p) {
 
 
 int main(int argc, char **argv) {
-    bool verbose;
+    bool verbose = false;
+    int region_size = 1000;
+    int threads = thread::hardware_concurrency();
 
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " SOURCE [-v]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " SOURCE [-v] [-r REGION_SIZE] [-j THREADS]" << std::endl;
         return 1;
     }
     int32_t opt;
-    while ((opt = getopt(argc, argv, "v")) != -1) {
+    while ((opt = getopt(argc, argv, "vr:j:")) != -1) {
         switch (opt) {
             case 'v':
                 verbose = true;
                 break;
+            case 'r':
+                region_size = atoi(optarg);
+                break;
+            case 'j':
+                threads = atoi(optarg);
+                break;
             default:
-                std::cerr << "Usage: " << argv[0] << "[-v] SOURCE" << std::endl;
+                std::cerr << "Usage: " << argv[0] << "[-v] [-r REGION_SIZE] [-j THREADS] SOURCE" << std::endl;
                 return 1;
         }
     }
@@ -140,21 +202,55 @@ int main(int argc, char **argv) {
     output.open("prog.L1");
     Program p = L2_parse_file(argv[optind]);
 
-    for (int i = 0; i < p.functions.size(); i++) {
-        map<string, string> reg_map;
-        set<string> spill_set;
-        do {
-            reg_map.clear();
-            spill_set.clear();
-            map<string, set<string>> graph = compute_interference_graph(p.functions[i]);
-            graph_coloring(graph, reg_map, spill_set);
-            p.functions[i] = replace_and_spill(p.functions[i], reg_map, spill_set);
-        } while (!spill_set.empty());
+    int n = p.functions.size();
+    vector<int64_t> original_locals(n);
+    run_jobs(vector<vector<int>>(n), threads, [&](int i) {
+        original_locals[i] = p.functions[i]->locals;
+        rename_webs(p.functions[i]);
+        optimize(p.functions[i]);
+        schedule_blocks(p.functions[i]);
+        insert_callee_saves(p.functions[i]);
+    });
+
+    /*
+     * Callees are allocated before their callers, so that every direct call only kills the
+     * caller-saved registers its callee actually writes. Components of the call graph that
+     * do not call each other are allocated in parallel, the functions of one component in
+     * a fixed order, so the output does not depend on the number of threads.
+     * */
+    vector<vector<int>> callee_components;
+    vector<vector<int>> components = call_graph_components(p, callee_components);
+    vector<string> logs(n);
+    run_jobs(callee_components, threads, [&](int c) {
+        for (int i : components[c]) {
+            ostringstream log;
+            if (region_size > 0 && p.functions[i]->instructions.size() > 2 * region_size) {
+                p.functions[i] = allocate_by_regions(p.functions[i], region_size, verbose ? &log : NULL);
+            } else {
+                p.functions[i] = allocate_registers(p.functions[i]);
+            }
+            shrink_wrap_callee_saves(p.functions[i]);
+            int64_t spilled_locals = p.functions[i]->locals;
+            color_stack_slots(p.functions[i], original_locals[i]);
+            record_clobbers(p.functions[i]);
+            log << p.functions[i]->name << ": frame " << spilled_locals * 8 << " -> "
+                << p.functions[i]->locals * 8 << " bytes, clobbers "
+                << __builtin_popcount(call_clobbers(p.functions[i]->name)) << " caller-saved registers" << endl;
+            logs[i] = log.str();
+        }
+    });
+    if (verbose) {
+        for (auto const &component : components) {
+            for (int i : component) {
+                cerr << logs[i];
+            }
+        }
     }
 
-    remove_stack_arg(p);
+    remove_stack_arg(p, getenv("NATIVE_CALLS") != NULL && string(getenv("NATIVE_CALLS")) == "1");
     output << p << endl;
 
     output.close();
+    arena::report("L2");
     return 0;
 }
@@ -1,88 +1,109 @@
-#include <map>
-#include <set>
 #include <string>
 #include <vector>
 
 #include "L2.h"
 #include "liveness.h"
+#include "interference.h"
 
 using namespace std;
 
 namespace L2 {
-    set<string> registers = {"rax", "rdi", "rsi", "rdx", "rcx", "r8", "r9", "r10",
-                             "r11", "r12", "r13", "r14", "r15", "rbp", "rbx"};
+    const int32_t rcx_id = 4;
 
-    inline bool isNumber(string operand) {
-        return operand[0] == '+' || operand[0] == '-' || (operand[0] >= '0' && operand[0] <= '9');
-    }
+    Interference_Graph compute_interference_graph(const Function *f) {
+        Live_Bits live = live_analysis(f);
+        int n = f->instructions.size(), words = live.words, ids = f->names.size();
 
-    void add_into_graph(map<string, set<string>> &graph, const string &key, const string &value) {
-        if (key != value) {
-            if (graph.find(key) == graph.end()) {
-                set<string> s;
-                graph[key] = s;
+        /*
+         * One row of bits per register or variable. A node only exists in the graph once it
+         * gets an edge, is a register, or is written somewhere.
+         * */
+        vector<uint64_t> edges(ids * words, 0);
+        vector<bool> node(ids, false);
+        auto add_edge = [&](int32_t a, int32_t b) {
+            if (a != b) {
+                edges[a * words + b / 64] |= (uint64_t)1 << (b % 64);
+                edges[b * words + a / 64] |= (uint64_t)1 << (a % 64);
+                node[a] = node[b] = true;
             }
-            if (graph.find(value) == graph.end()) {
-                set<string> s;
-                graph[value] = s;
+        };
+
+        for (int32_t reg = 0; reg < rsp_id; reg++) {
+            for (int32_t other = 0; other < rsp_id; other++) {
+                add_edge(reg, other);
             }
-            graph[key].insert(value);
-            graph[value].insert(key);
         }
-    }
-
-    void add_sets_into_graph(map<string, set<string>> &graph, const vector<set<string>> s) {
-        for (int i = 0; i < s.size(); i++) {
-            vector<string> v(s[i].begin(), s[i].end());
-            for (int j = 0; j < (int)v.size() - 1; j++) {
-                for (int k = j + 1; k < v.size(); k++) {
-                    add_into_graph(graph, v[j], v[k]);
-                }
+        for (int i = 0; i < n; i++) {
+            for (int32_t id : set_bits(live.kill, i, words)) {
+                node[id] = true;
             }
         }
-    }
-
-    map<string, set<string>> compute_interference_graph(Function *f) {
-        vector<set<string>> gen, kill, in, out;
-        live_analysis(f, gen, kill, in, out);
 
-        map<string, set<string>> graph;
-        for (auto const &reg : registers) {
-            set<string> s = registers;
-            s.erase(reg);
-            graph[reg] = s;
+        /*
+         * Everything live at the same point interferes.
+         * */
+        for (auto const *bits : {&live.in, &live.out}) {
+            for (int i = 0; i < n; i++) {
+                const uint64_t *row = bits->data() + i * words;
+                int count = 0;
+                for (int w = 0; w < words; w++) {
+                    count += __builtin_popcountll(row[w]);
+                }
+                if (count < 2) {
+                    continue;
+                }
+                for (int32_t id : set_bits(*bits, i, words)) {
+                    node[id] = true;
+                    for (int w = 0; w < words; w++) {
+                        edges[id * words + w] |= row[w];
+                    }
+                    edges[id * words + id / 64] &= ~((uint64_t)1 << (id % 64));
+                }
+            }
         }
 
-        add_sets_into_graph(graph, in);
-        add_sets_into_graph(graph, out);
-
-        for (int i = 0; i < kill.size(); i++) {
-            Instruction *inst = f->instructions[i];
-            for (auto const &k : kill[i]) {
-                for (auto const &o : out[i]) {
-                    if (inst->operators.size() == 1 && inst->operators.front() == Operator_Type::MOVQ &&
-                        k == inst->operands[0] && o == inst->operands[1]) {
-                        continue;
-                    } else {
-                        add_into_graph(graph, k, o);
+        for (int i = 0; i < n; i++) {
+            const Instruction &inst = *f->instructions[i];
+            bool move = inst.operator_count == 1 && inst.operators[0] == Operator_Type::MOVQ &&
+                        (inst.operands[1].kind == REGISTER || inst.operands[1].kind == VARIABLE);
+            for (int32_t k : set_bits(live.kill, i, words)) {
+                for (int32_t o : set_bits(live.out, i, words)) {
+                    if (!(move && inst.operands[0].id == k && inst.operands[1].id == o)) {
+                        add_edge(k, o);
                     }
                 }
             }
         }
 
-        for (int i = 0; i < kill.size(); i++) {
-            Instruction *inst = f->instructions[i];
-            if ((inst->operators[0] == Operator_Type::SALQ || inst->operators[0] == Operator_Type::SARQ) &&
-                    !isNumber(inst->operands[1])) {
-                set<string> s = registers;
-                s.erase("rcx");
-                for (auto const &reg : s) {
-                    add_into_graph(graph, inst->operands[1], reg);
+        /*
+         * A variable shift count has to end up in rcx.
+         * */
+        for (int i = 0; i < n; i++) {
+            const Instruction &inst = *f->instructions[i];
+            const Operand *count = NULL;
+            if (inst.operators[0] == Operator_Type::SALQ || inst.operators[0] == Operator_Type::SARQ) {
+                count = &inst.operands[1];
+            } else if (inst.operators[0] == Operator_Type::MEM &&
+                       (inst.operators[1] == Operator_Type::SALQ || inst.operators[1] == Operator_Type::SARQ)) {
+                count = &inst.operands[2];
+            }
+            if (count != NULL && is_name(*count)) {
+                for (int32_t reg = 0; reg < rsp_id; reg++) {
+                    if (reg != rcx_id) {
+                        add_edge(count->id, reg);
+                    }
                 }
             }
         }
 
+        Interference_Graph graph;
+        graph.node = node;
+        graph.adjacent.resize(ids);
+        for (int32_t id = 0; id < ids; id++) {
+            if (node[id]) {
+                graph.adjacent[id] = set_bits(edges, id, words);
+            }
+        }
         return graph;
-
     }
-}
\ No newline at end of file
+}
@@ -1,13 +1,21 @@
 #pragma once
 
-#include <map>
-#include <set>
-#include <string>
+#include <vector>
+#include <cstdint>
 
 #include "L2.h"
 
 using namespace std;
 
 namespace L2 {
-    map<string, set<string>> compute_interference_graph(Function *f);
-}
\ No newline at end of file
+    /*
+     * Interference graph over the register and variable ids of a function. Only the ids
+     * with node set are part of the graph, adjacent lists the neighbors of each one.
+     * */
+    struct Interference_Graph {
+        vector<bool> node;
+        vector<vector<int32_t>> adjacent;
+    };
+
+    Interference_Graph compute_interference_graph(const Function *f);
+}
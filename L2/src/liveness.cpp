@@ -3,43 +3,52 @@
 #include <algorithm>
 #include <set>
 #include <unistd.h>
-#include <map>
 #include <iostream>
 
 #include "L2.h"
+#include "liveness.h"
+#include "clobbers.h"
 
 using namespace std;
 
 namespace L2 {
-    inline void insert_var(set<string> &ss, string &s, bool flag = true) {
-        if (flag || (s != "rsp" && s[0] != ':' && s[0] != '+' && s[0] != '-' && (s[0] < '0' || s[0] > '9'))) {
-            ss.insert(s);
+    inline void insert_var(Live_Bits &live, vector<uint64_t> &bits, int i, const Operand &o, bool flag = true) {
+        /*
+         * Without flag, rsp, labels and numbers are not variables.
+         * */
+        if (o.kind == VARIABLE || (o.kind == REGISTER && (flag || o.id != rsp_id))) {
+            bits[i * live.words + o.id / 64] |= (uint64_t)1 << (o.id % 64);
         }
     }
 
-    void live_analysis(Function *f, std::vector<set<string>> &gen, vector<set<string>> &kill, vector<set<string>> &in, vector<set<string>> &out) {
-        vector<Instruction *> instructions = f->instructions;
-        int n = instructions.size();
-        for (int idx = 0; idx < n; idx++) {
-            set<string> g, k, i, o;
-            gen.push_back(g);
-            kill.push_back(k);
-            in.push_back(i);
-            out.push_back(o);
-        }
-        map <string, int> m;
-        for (int i = 0; i < instructions.size(); i++) {
-            Instruction *inst = instructions[i];
-            switch (inst->operators.front()) {
+    inline void insert_register(Live_Bits &live, vector<uint64_t> &bits, int i, int32_t id) {
+        bits[i * live.words + id / 64] |= (uint64_t)1 << (id % 64);
+    }
+
+    const vector<string> argument_registers = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+    const vector<string> return_registers = {"rax", "r12", "r13", "r14", "r15", "rbp", "rbx"};
+
+    Live_Bits live_analysis(const Function *f) {
+        int n = f->instructions.size();
+        Live_Bits live;
+        live.words = (f->names.size() + 63) / 64;
+        live.gen.assign(n * live.words, 0);
+        live.kill.assign(n * live.words, 0);
+        live.in.assign(n * live.words, 0);
+        live.out.assign(n * live.words, 0);
+
+        vector<int> label_index(f->labels.size(), 0);
+        vector<int64_t> clobbers(f->labels.size(), -1);
+        for (int i = 0; i < n; i++) {
+            const Instruction &inst = *f->instructions[i];
+            const Operand *operands = inst.operands;
+            switch (inst.operators[0]) {
                 case Operator_Type::MOVQ:
-                    insert_var(kill[i], inst->operands[0]);
-                    if (inst->operators.size() == 1) {
-                        insert_var(gen[i], inst->operands[1], false);
-                    } else if (inst->operators[1] == Operator_Type::MEM) {
-                        insert_var(gen[i], inst->operands[1], false);
-                    } else if (inst->operators[1] != Operator_Type::STACK_ARG) {
-                        insert_var(gen[i], inst->operands[1], false);
-                        insert_var(gen[i], inst->operands[2], false);
+                    insert_var(live, live.kill, i, operands[0]);
+                    if (inst.operator_count == 1 || inst.operators[1] != Operator_Type::STACK_ARG) {
+                        for (int j = 1; j < inst.operand_count; j++) {
+                            insert_var(live, live.gen, i, operands[j], false);
+                        }
                     }
                     break;
                 case Operator_Type::ADDQ:
@@ -48,62 +57,69 @@ namespace L2 {
                 case Operator_Type::ANDQ:
                 case Operator_Type::SALQ:
                 case Operator_Type::SARQ:
-                    insert_var(kill[i], inst->operands[0]);
-                    insert_var(gen[i], inst->operands[0]);
-                    insert_var(gen[i], inst->operands[1], inst->operators.size() > 1);
+                    insert_var(live, live.kill, i, operands[0]);
+                    insert_var(live, live.gen, i, operands[0]);
+                    insert_var(live, live.gen, i, operands[1], inst.operator_count > 1);
                     break;
                 case Operator_Type::CJUMP:
-                    insert_var(gen[i], inst->operands[0], false);
-                    insert_var(gen[i], inst->operands[1], false);
+                    for (int j = 0; j < inst.operand_count - 2; j++) {
+                        insert_var(live, live.gen, i, operands[j], false);
+                    }
                     break;
                 case Operator_Type::LABEL:
-                    m[inst->operands[0]] = i;
+                    label_index[operands[0].id] = i;
                 case Operator_Type::GOTO:
                     break;
                 case Operator_Type::RETURN:
-                    gen[i] = {"rax", "r12", "r13", "r14", "r15", "rbp", "rbx"};
+                    for (auto const &reg : return_registers) {
+                        insert_register(live, live.gen, i, register_id(reg));
+                    }
                     break;
-                case Operator_Type::CALL:
-                    kill[i] = {"r10", "r11", "r8", "r9", "rax", "rcx", "rdi", "rdx", "rsi"};
-                    switch ((int)stoll(inst->operands[1])) {
-                        case 0:
-                            break;
-                        case 1:
-                            gen[i] = {"rdi"};
-                            break;
-                        case 2:
-                            gen[i] = {"rdi", "rsi"};
-                            break;
-                        case 3:
-                            gen[i] = {"rdi", "rsi", "rdx"};
-                            break;
-                        case 4:
-                            gen[i] = {"rdi", "rsi", "rdx", "rcx"};
-                            break;
-                        case 5:
-                            gen[i] = {"rdi", "rsi", "rdx", "rcx", "r8"};
-                            break;
-                        default:
-                            gen[i] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
-                            break;
+                case Operator_Type::CALL: {
+                    int64_t killed;
+                    if (is_name(operands[0])) {
+                        killed = call_clobbers("");
+                    } else {
+                        if (clobbers[operands[0].id] == -1) {
+                            clobbers[operands[0].id] = call_clobbers(f->labels[operands[0].id]);
+                        }
+                        killed = clobbers[operands[0].id];
+                    }
+                    for (int32_t id = 0; id < rsp_id; id++) {
+                        if ((killed >> id) & 1) {
+                            insert_register(live, live.kill, i, id);
+                        }
                     }
-                    if (inst->operands[0] != "print" && inst->operands[0] != "allocate" && inst->operands[0] != "array-error") {
-                        insert_var(gen[i], inst->operands[0], false);
+                    int64_t arguments = operands[1].value;
+                    int count = arguments == 0 ? 0 : (arguments >= 1 && arguments <= 5 ? arguments : 6);
+                    for (int j = 0; j < count; j++) {
+                        insert_register(live, live.gen, i, register_id(argument_registers[j]));
+                    }
+                    if (operands[0].kind != RUNTIME_FUNCTION) {
+                        insert_var(live, live.gen, i, operands[0], false);
                     }
                     break;
+                }
                 case Operator_Type::CISC:
-                    insert_var(kill[i], inst->operands[0]);
-                    insert_var(gen[i], inst->operands[1]);
-                    insert_var(gen[i], inst->operands[2]);
+                    insert_var(live, live.kill, i, operands[0]);
+                    insert_var(live, live.gen, i, operands[1]);
+                    insert_var(live, live.gen, i, operands[2]);
                     break;
                 case Operator_Type::MEM:
-                    insert_var(gen[i], inst->operands[0], false);
-                    insert_var(gen[i], inst->operands[2], false);
+                    insert_var(live, live.gen, i, operands[0], false);
+                    if (inst.operand_count > 2) {
+                        insert_var(live, live.gen, i, operands[2], false);
+                    }
+                    break;
+                case Operator_Type::MEM_INDEX:
+                    insert_var(live, live.gen, i, operands[0], false);
+                    insert_var(live, live.gen, i, operands[1]);
+                    insert_var(live, live.gen, i, operands[4], false);
                     break;
                 case Operator_Type::INC:
                 case Operator_Type::DEC:
-                    insert_var(gen[i], inst->operands[0]);
-                    insert_var(kill[i], inst->operands[0]);
+                    insert_var(live, live.gen, i, operands[0]);
+                    insert_var(live, live.kill, i, operands[0]);
                     break;
                 default:
                     cerr << "\tERROR ASSEMBLY";
@@ -111,46 +127,66 @@ namespace L2 {
             }
         }
 
+        /*
+         * in = gen | (out & ~kill), out is the union of the in sets of the successors.
+         * */
+        int words = live.words;
+        vector<uint64_t> out_tmp(words);
         bool flag = true;
-        int idx1, idx2;
         while (flag) {
             flag = false;
             for (int i = n - 1; i >= 0; i--) {
-                Instruction *inst = instructions[i];
-                set<string> out_tmp, in_tmp;
-                switch (inst->operators.front()) {
+                const Instruction &inst = *f->instructions[i];
+                fill(out_tmp.begin(), out_tmp.end(), 0);
+                int successors[2] = {-1, -1};
+                switch (inst.operators[0]) {
                     case Operator_Type::CJUMP:
-                        idx1 = m[inst->operands[2]];
-                        idx2 = m[inst->operands[3]];
-                        out_tmp = in[idx1];
-                        out_tmp.insert(in[idx2].begin(), in[idx2].end());
+                        successors[0] = label_index[inst.operands[inst.operand_count - 2].id];
+                        successors[1] = label_index[inst.operands[inst.operand_count - 1].id];
                         break;
                     case Operator_Type::GOTO:
-                        out_tmp = in[m[inst->operands[0]]];
+                        successors[0] = label_index[inst.operands[0].id];
                         break;
                     case Operator_Type::RETURN:
                         break;
                     default:
                         if (i < n - 1) {
-                            out_tmp = in[i + 1];
+                            successors[0] = i + 1;
                         }
                         break;
                 }
-                if (out_tmp != out[i]) {
-                    out[i] = out_tmp;
-                    flag = true;
+                for (int s : successors) {
+                    if (s != -1) {
+                        for (int w = 0; w < words; w++) {
+                            out_tmp[w] |= live.in[s * words + w];
+                        }
+                    }
                 }
-                for (auto x : out[i]) {
-                    if (kill[i].count(x) == 0) {
-                        in_tmp.insert(x);
+                for (int w = 0; w < words; w++) {
+                    uint64_t in_tmp = live.gen[i * words + w] | (out_tmp[w] & ~live.kill[i * words + w]);
+                    if (out_tmp[w] != live.out[i * words + w] || in_tmp != live.in[i * words + w]) {
+                        live.out[i * words + w] = out_tmp[w];
+                        live.in[i * words + w] = in_tmp;
+                        flag = true;
                     }
                 }
-                in_tmp.insert(gen[i].begin(), gen[i].end());
-                if (in_tmp != in[i]) {
-                    in[i] = in_tmp;
-                    flag = true;
+            }
+        }
+        return live;
+    }
+
+    vector<bool> call_crossing_variables(const Function *f) {
+        Live_Bits live = live_analysis(f);
+        vector<bool> crossing(f->names.size(), false);
+        for (int i = 0; i < f->instructions.size(); i++) {
+            if (f->instructions[i]->operators[0] == Operator_Type::CALL) {
+                for (int32_t id : set_bits(live.out, i, live.words)) {
+                    if (!live.test(live.kill, i, id)) {
+                        crossing[id] = true;
+                    }
                 }
             }
         }
+        return crossing;
     }
-}
\ No newline at end of file
+}
@@ -2,11 +2,48 @@
 
 #include <vector>
 #include <set>
+#include <algorithm>
 
 #include "L2.h"
 
 using namespace std;
 
 namespace L2 {
-    void live_analysis(Function *f, vector<set<string>> &gen, vector<set<string>> &kill, vector<set<string>> &in, vector<set<string>> &out);
-}
\ No newline at end of file
+    /*
+     * Liveness of a function, words 64-bit words per instruction with one bit for every
+     * register and variable id.
+     * */
+    struct Live_Bits {
+        int words;
+        vector<uint64_t> gen, kill, in, out;
+
+        inline bool test(const vector<uint64_t> &bits, int i, int32_t id) const {
+            return (bits[i * words + id / 64] >> (id % 64)) & 1;
+        }
+    };
+
+    inline vector<int32_t> set_bits(const vector<uint64_t> &bits, int row, int words) {
+        vector<int32_t> ids;
+        for (int w = 0; w < words; w++) {
+            uint64_t word = bits[row * words + w];
+            while (word != 0) {
+                ids.push_back(w * 64 + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+        return ids;
+    }
+
+    /*
+     * Ids set in a row, sorted by name as a set<string> would iterate them.
+     * */
+    inline vector<int32_t> sorted_by_name(const Function *f, const vector<uint64_t> &bits, int row, int words) {
+        vector<int32_t> ids = set_bits(bits, row, words);
+        sort(ids.begin(), ids.end(), [f](int32_t a, int32_t b) { return f->names[a].str() < f->names[b].str(); });
+        return ids;
+    }
+
+    Live_Bits live_analysis(const Function *f);
+
+    vector<bool> call_crossing_variables(const Function *f);
+}
@@ -0,0 +1,83 @@
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "L2.h"
+
+using namespace std;
+
+namespace L2 {
+    /*
+     * A constant array, so the tables other files build from it at startup never see it
+     * uninitialized.
+     * */
+    const char *const register_names[register_count] = {"rax", "rdi", "rsi", "rdx", "rcx", "r8", "r9", "r10",
+                                                        "r11", "r12", "r13", "r14", "r15", "rbp", "rbx", "rsp"};
+
+    int32_t register_id(const string &name) {
+        for (int32_t i = 0; i < register_count; i++) {
+            if (register_names[i] == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool set_instruction(Instruction *inst, initializer_list<Operator_Type> operators,
+                         initializer_list<Operand> operands) {
+        inst->operator_count = inst->operand_count = 0;
+        for (auto op : operators) {
+            inst->operators[inst->operator_count++] = op;
+        }
+        for (auto const &o : operands) {
+            inst->operands[inst->operand_count++] = o;
+        }
+        return true;
+    }
+
+    Instruction *new_instruction(initializer_list<Operator_Type> operators, initializer_list<Operand> operands) {
+        Instruction *inst = new Instruction;
+        set_instruction(inst, operators, operands);
+        return inst;
+    }
+
+    Operand new_variable(Function *f, const string &name) {
+        Operand o = {VARIABLE, (int32_t)f->names.size(), 0};
+        f->names.push_back(name);
+        return o;
+    }
+
+    vector<int32_t> drop_unused_names(Function *f) {
+        vector<int32_t> ids(f->names.size(), -1), old_ids;
+        vector<symbol::Symbol> names(f->names.begin(), f->names.begin() + register_count);
+        for (int32_t reg = 0; reg < register_count; reg++) {
+            ids[reg] = reg;
+            old_ids.push_back(reg);
+        }
+        for (auto const &inst : f->instructions) {
+            for (int j = 0; j < inst->operand_count; j++) {
+                Operand &o = inst->operands[j];
+                if (o.kind == VARIABLE) {
+                    if (ids[o.id] == -1) {
+                        ids[o.id] = names.size();
+                        old_ids.push_back(o.id);
+                        names.push_back(f->names[o.id]);
+                    }
+                    o.id = ids[o.id];
+                }
+            }
+        }
+        f->names = names;
+        return old_ids;
+    }
+
+    Function *empty_copy(const Function *f) {
+        Function *func = new Function;
+        func->name = f->name;
+        func->arguments = f->arguments;
+        func->locals = f->locals;
+        func->names = f->names;
+        func->labels = f->labels;
+        return func;
+    }
+}
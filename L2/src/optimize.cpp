@@ -0,0 +1,145 @@
+#include <vector>
+#include <set>
+#include <map>
+#include <cstdint>
+
+#include "L2.h"
+#include "liveness.h"
+#include "callee_save.h"
+
+using namespace std;
+
+namespace L2 {
+    inline bool fits_imm32(const Operand &o) {
+        return o.value >= INT32_MIN && o.value <= INT32_MAX;
+    }
+
+    bool is_propagatable_copy(const Instruction *inst) {
+        if (inst->operator_count != 1 || inst->operators[0] != Operator_Type::MOVQ ||
+                inst->operands[0].kind != VARIABLE || inst->operands[0] == inst->operands[1]) {
+            return false;
+        }
+        const Operand &src = inst->operands[1];
+        return src.kind == LABEL_NAME || src.kind == VARIABLE || (src.kind == NUMBER && fits_imm32(src));
+    }
+
+    bool accepts_operand(const Instruction *inst, int j, const Operand &value) {
+        /*
+         * Whether the use at operands[j] can be replaced by value without leaving the L2
+         * grammar. Any use of a variable can take another variable.
+         * */
+        if (value.kind == VARIABLE) {
+            return true;
+        }
+        if (inst->operators[0] == Operator_Type::CISC || j == mem_operand_index(inst) || is_address_register(inst, j)) {
+            return false;
+        }
+        if (value.kind == LABEL_NAME) {
+            return (inst->operator_count == 1 && inst->operators[0] == Operator_Type::MOVQ) ||
+                   (inst->operators[0] == Operator_Type::MEM && inst->operators[1] == Operator_Type::MOVQ) ||
+                   inst->operators[0] == Operator_Type::MEM_INDEX ||
+                   inst->operators[0] == Operator_Type::CALL;
+        }
+        return inst->operators[0] != Operator_Type::CALL;
+    }
+
+    bool propagate_copies(Function *f) {
+        /*
+         * Forward analysis of the copies (x <- y) and constant assignments (x <- c) that hold
+         * on every path into an instruction. A use of x is then replaced by y or c.
+         * */
+        int n = f->instructions.size();
+        vector<vector<int>> succ = successors(f);
+        vector<map<int32_t, Operand>> in(n);
+        vector<bool> reached(n, false);
+        reached[0] = n > 0;
+        bool flag = true;
+        while (flag) {
+            flag = false;
+            for (int i = 0; i < n; i++) {
+                if (!reached[i]) {
+                    continue;
+                }
+                Instruction *inst = f->instructions[i];
+                map<int32_t, Operand> out = in[i];
+                if (writes_first_operand(inst)) {
+                    const Operand &dest = inst->operands[0];
+                    for (auto it = out.begin(); it != out.end();) {
+                        if ((dest.kind == VARIABLE && it->first == dest.id) || it->second == dest) {
+                            it = out.erase(it);
+                        } else {
+                            it++;
+                        }
+                    }
+                    if (is_propagatable_copy(inst)) {
+                        out[dest.id] = inst->operands[1];
+                    }
+                }
+                for (auto const &s : succ[i]) {
+                    if (!reached[s]) {
+                        reached[s] = true;
+                        in[s] = out;
+                        flag = true;
+                        continue;
+                    }
+                    for (auto it = in[s].begin(); it != in[s].end();) {
+                        auto other = out.find(it->first);
+                        if (other == out.end() || other->second != it->second) {
+                            it = in[s].erase(it);
+                            flag = true;
+                        } else {
+                            it++;
+                        }
+                    }
+                }
+            }
+        }
+
+        bool changed = false;
+        for (int i = 0; i < n; i++) {
+            Instruction *inst = f->instructions[i];
+            int first_use = writes_first_operand(inst) ? 1 : 0;
+            for (int j = first_use; j < inst->operand_count; j++) {
+                if (inst->operands[j].kind != VARIABLE) {
+                    continue;
+                }
+                auto copy = in[i].find(inst->operands[j].id);
+                if (copy != in[i].end() && accepts_operand(inst, j, copy->second)) {
+                    inst->operands[j] = copy->second;
+                    changed = true;
+                }
+            }
+        }
+        return changed;
+    }
+
+    bool eliminate_dead_code(Function *f) {
+        /*
+         * Removes the instructions whose only effect is to define a variable that is not
+         * live afterwards. Stores and calls are always kept.
+         * */
+        Live_Bits live = live_analysis(f);
+        vector<Instruction *> kept;
+        for (int i = 0; i < f->instructions.size(); i++) {
+            Instruction *inst = f->instructions[i];
+            bool self_copy = inst->operator_count == 1 && inst->operators[0] == Operator_Type::MOVQ &&
+                             inst->operands[0] == inst->operands[1];
+            if (self_copy || (writes_first_operand(inst) && inst->operands[0].kind == VARIABLE &&
+                    !live.test(live.out, i, inst->operands[0].id))) {
+                continue;
+            }
+            kept.push_back(inst);
+        }
+        bool changed = kept.size() != f->instructions.size();
+        f->instructions = kept;
+        return changed;
+    }
+
+    void optimize(Function *f) {
+        bool changed = true;
+        while (changed) {
+            changed = propagate_copies(f);
+            changed = eliminate_dead_code(f) || changed;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "parallel.h"
+
+using namespace std;
+
+namespace L2 {
+    void run_jobs(const vector<vector<int>> &depends_on, int threads, const function<void(int)> &job) {
+        /*
+         * Runs job(0) ... job(n - 1) on a pool of threads, each one only after the jobs it
+         * depends on are done. Jobs must write their results to their own slots, the caller
+         * reads them in whatever order it wants once run_jobs returns.
+         * */
+        int n = depends_on.size();
+        vector<int> waiting(n);
+        vector<vector<int>> dependents(n);
+        deque<int> ready;
+        for (int j = 0; j < n; j++) {
+            waiting[j] = depends_on[j].size();
+            for (int d : depends_on[j]) {
+                dependents[d].push_back(j);
+            }
+            if (waiting[j] == 0) {
+                ready.push_back(j);
+            }
+        }
+        if (threads <= 1) {
+            while (!ready.empty()) {
+                int j = ready.front();
+                ready.pop_front();
+                job(j);
+                for (int d : dependents[j]) {
+                    if (--waiting[d] == 0) {
+                        ready.push_back(d);
+                    }
+                }
+            }
+            return;
+        }
+
+        mutex m;
+        condition_variable changed;
+        int done = 0;
+        auto worker = [&]() {
+            unique_lock<mutex> lock(m);
+            while (true) {
+                changed.wait(lock, [&]() { return !ready.empty() || done == n; });
+                if (ready.empty()) {
+                    return;
+                }
+                int j = ready.front();
+                ready.pop_front();
+                lock.unlock();
+                job(j);
+                lock.lock();
+                done++;
+                for (int d : dependents[j]) {
+                    if (--waiting[d] == 0) {
+                        ready.push_back(d);
+                    }
+                }
+                changed.notify_all();
+            }
+        };
+        vector<thread> pool;
+        for (int t = 0; t < threads && t < n; t++) {
+            pool.push_back(thread(worker));
+        }
+        for (auto &t : pool) {
+            t.join();
+        }
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+namespace L2 {
+    void run_jobs(const vector<vector<int>> &depends_on, int threads, const function<void(int)> &job);
+}
@@ -9,6 +9,7 @@
 #include <cstdlib>
 #include <stdint.h>
 #include <assert.h>
+#include <iostream>
 
 #include "L2.h"
 #include <pegtl.hh>
@@ -84,7 +85,7 @@ namespace L2 {
 
     struct operand_s : pegtl::sor<operand_t, label> {};
 
-    struct operand_E : pegtl::sor<pegtl::one<'0'>, pegtl::one<'2'>, pegtl::one<'4'>, pegtl::one<'8'>> {};
+    struct operand_E : pegtl::sor<pegtl::one<'1'>, pegtl::one<'2'>, pegtl::one<'4'>, pegtl::one<'8'>> {};
 
     struct operand_M : number {};
 
@@ -140,6 +141,18 @@ namespace L2 {
 
     struct inst_mem : pegtl::seq<pegtl::one<'('>, seps, mem, seps, x, seps, M, seps, pegtl::one<')'>> {};
 
+    struct mem_index : pegtl::string<'m', 'e', 'm'> {};
+
+    /*
+     * (mem x w E M) addresses x + w * E + M. The lookahead runs without actions, so a plain
+     * (mem x M) leaves no operands behind when it does not match.
+     * */
+    struct inst_mem_index :
+        pegtl::seq<
+            pegtl::at<pegtl::one<'('>, seps, mem, seps, operand_x, seps, operand_w, seps, operand_E, seps, operand_M, seps, pegtl::one<')'>>,
+            pegtl::one<'('>, seps, mem_index, seps, x, seps, w, seps, E, seps, M, seps, pegtl::one<')'>
+        > {};
+
     struct stack_arg : pegtl::string<'s', 't', 'a', 'c', 'k', '-', 'a', 'r', 'g'> {};
 
     struct inst_stack_arg : pegtl::seq<pegtl::one<'('>, seps, stack_arg, seps, M, seps, pegtl::one<')'>> {};
@@ -177,14 +190,24 @@ namespace L2 {
                 inst_start,
                 seps,
                 pegtl::sor<
+                    pegtl::seq<inst_mem_index, seps, operator_movq, seps, s>,
                     pegtl::seq<
                         inst_mem, seps,
                         pegtl::sor<
+                            operator_inc, operator_dec,
                             pegtl::seq<operator_movq, seps, s>,
-                            pegtl::seq<pegtl::sor<operator_addq, operator_subq>, seps, t>
+                            pegtl::seq<operator_sop, seps, operand_sop>,
+                            pegtl::seq<pegtl::sor<operator_addq, operator_subq, operator_andq>, seps, t>
                         >
                     >,
-                    pegtl::seq<inst_cjump, seps, t, seps, operator_cmp, seps, t, seps, inst_cjump_label, seps, inst_cjump_label>,
+                    pegtl::seq<
+                        inst_cjump, seps,
+                        pegtl::sor<
+                            pegtl::seq<t, seps, operator_cmp, seps, pegtl::sor<t, inst_mem>>,
+                            pegtl::seq<inst_mem, seps, operator_cmp, seps, t>
+                        >,
+                        seps, inst_cjump_label, seps, inst_cjump_label
+                    >,
                     pegtl::seq<inst_goto, seps, goto_label>,
                     inst_return,
                     pegtl::seq<
@@ -193,12 +216,20 @@ namespace L2 {
                                 operator_inc, operator_dec,
                                 pegtl::seq<
                                 operator_movq, seps,
-                                pegtl::sor<pegtl::seq<t, seps, operator_cmp, seps, t>, s, inst_mem, inst_stack_arg>
+                                pegtl::sor<
+                                    pegtl::seq<t, seps, operator_cmp, seps, pegtl::sor<t, inst_mem>>,
+                                    s,
+                                    inst_mem_index,
+                                    pegtl::seq<inst_mem, pegtl::opt<seps, operator_cmp, seps, t>>,
+                                    inst_stack_arg
+                                >
                             >,
                             pegtl::seq<operator_at, seps, w, seps, w, seps, E>,
                             pegtl::seq<operator_sop, seps, operand_sop>,
-                            pegtl::seq<pegtl::sor<operator_addq, operator_subq>, seps, pegtl::sor<t, inst_mem>>,
-                            pegtl::seq<pegtl::sor<operator_imulq, operator_andq>, seps, t>
+                            pegtl::seq<
+                                pegtl::sor<operator_addq, operator_subq, operator_imulq, operator_andq>, seps,
+                                pegtl::sor<t, inst_mem>
+                            >
                         >
                     >,
                     pegtl::seq<inst_call, seps, pegtl::sor<inst_print, inst_array_error, inst_allocate, u>, seps, inst_call_number>
@@ -250,6 +281,64 @@ namespace L2 {
 
 
 
+    /*
+     * Local ids of the names and labels of the function being parsed, indexed by symbol id.
+     * Operands are classified once here, the passes only see typed operands.
+     * */
+    vector<int32_t> name_ids, label_ids;
+
+    int32_t local_id(vector<int32_t> &ids, vector<symbol::Symbol> &names, const symbol::Symbol &s) {
+        if (ids.size() <= s.id()) {
+            ids.resize(s.id() + 1024, -1);
+        }
+        if (ids[s.id()] == -1) {
+            ids[s.id()] = names.size();
+            names.push_back(s);
+        }
+        return ids[s.id()];
+    }
+
+    void end_function(Function *f) {
+        for (auto const &s : f->names) {
+            name_ids[s.id()] = -1;
+        }
+        for (auto const &s : f->labels) {
+            label_ids[s.id()] = -1;
+        }
+    }
+
+    void push_operand(Program &p, const pegtl::input &in, Operand_Kind kind = NO_OPERAND) {
+        Function *f = p.functions.back();
+        Instruction *inst = f->instructions.back();
+        if (inst->operand_count == 5) {
+            cerr << "\tERROR L2: instruction with more than 5 operands" << endl;
+            abort();
+        }
+        Operand &o = inst->operands[inst->operand_count++];
+        o.value = 0;
+        o.id = -1;
+        const char *s = in.begin();
+        if (s[0] == '+' || s[0] == '-' || (s[0] >= '0' && s[0] <= '9')) {
+            o.kind = NUMBER;
+            o.value = strtoll(s, NULL, 10);
+        } else if (s[0] == ':' || kind == RUNTIME_FUNCTION) {
+            o.kind = s[0] == ':' ? LABEL_NAME : RUNTIME_FUNCTION;
+            o.id = local_id(label_ids, f->labels, symbol::Symbol(s, in.size()));
+        } else {
+            o.id = local_id(name_ids, f->names, symbol::Symbol(s, in.size()));
+            o.kind = o.id < register_count ? REGISTER : VARIABLE;
+        }
+    }
+
+    void push_operator(Program &p, Operator_Type op) {
+        Instruction *inst = p.functions.back()->instructions.back();
+        if (inst->operator_count == 3) {
+            cerr << "\tERROR L2: instruction with more than 3 operators" << endl;
+            abort();
+        }
+        inst->operators[inst->operator_count++] = op;
+    }
+
     template<typename Rule>
     struct action : pegtl::nothing<Rule> {};
 
@@ -267,8 +356,14 @@ namespace L2 {
             debug_line_number = 0;
             cout << in.string() << endl;
 #endif
+            if (!p.functions.empty()) {
+                end_function(p.functions.back());
+            }
             Function *newF = new Function();
             newF->name = in.string();
+            for (auto const &reg : register_names) {
+                local_id(name_ids, newF->names, reg);
+            }
             p.functions.push_back(newF);
         }
     };
@@ -290,56 +385,56 @@ namespace L2 {
     template<>
     struct action<w> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<s> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<t> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<u> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<x> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<E> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<M> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<operand_sop> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
@@ -349,10 +444,9 @@ namespace L2 {
 #ifdef DEBUG
             cout << (++debug_line_number) << "\t" << in.string() << endl;
 #endif
-            Instruction *newI = new Instruction();
-            newI->operators.push_back(Operator_Type::LABEL);
-            newI->operands.push_back(in.string());
-            p.functions.back()->instructions.push_back(newI);
+            p.functions.back()->instructions.push_back(new Instruction());
+            push_operator(p, Operator_Type::LABEL);
+            push_operand(p, in);
         }
     };
 
@@ -370,17 +464,15 @@ namespace L2 {
     struct action<inst_end> {
         static void apply(const pegtl::input &in, Program &p) {
             Instruction *inst = p.functions.back()->instructions.back();
-            if (inst->operators.size() == 1 && inst->operators[0] == Operator_Type::MOVQ) {
-                while (inst->operands.size() > 2) {
-                    inst->operands.pop_back();
-                }
+            if (inst->operator_count == 1 && inst->operators[0] == Operator_Type::MOVQ && inst->operand_count > 2) {
+                inst->operand_count = 2;
             }
 #ifdef DEBUG
-            for (auto const &d : p.functions.back()->instructions.back()->operands) {
-                cout << d << " ";
+            for (int j = 0; j < inst->operand_count; j++) {
+                cout << operand_name(p.functions.back(), inst->operands[j]) << " ";
             }
-            for (auto const &d : p.functions.back()->instructions.back()->operators) {
-                cout << d << " ";
+            for (int j = 0; j < inst->operator_count; j++) {
+                cout << inst->operators[j] << " ";
             }
             cout << in.string() << endl;
 #endif
@@ -390,176 +482,183 @@ namespace L2 {
     template<>
     struct action<operator_movq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::MOVQ);
+            push_operator(p, Operator_Type::MOVQ);
         }
     };
 
     template<>
     struct action<mem> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::MEM);
+            push_operator(p, Operator_Type::MEM);
+        }
+    };
+
+    template<>
+    struct action<mem_index> {
+        static void apply(const pegtl::input &in, Program &p) {
+            push_operator(p, Operator_Type::MEM_INDEX);
         }
     };
 
     template<>
     struct action<stack_arg> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::STACK_ARG);
+            push_operator(p, Operator_Type::STACK_ARG);
         }
     };
 
     template<>
     struct action<operator_addq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::ADDQ);
+            push_operator(p, Operator_Type::ADDQ);
         }
     };
 
     template<>
     struct action<operator_subq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::SUBQ);
+            push_operator(p, Operator_Type::SUBQ);
         }
     };
 
     template<>
     struct action<operator_imulq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::IMULQ);
+            push_operator(p, Operator_Type::IMULQ);
         }
     };
 
     template<>
     struct action<operator_andq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::ANDQ);
+            push_operator(p, Operator_Type::ANDQ);
         }
     };
 
     template<>
     struct action<operator_salq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::SALQ);
+            push_operator(p, Operator_Type::SALQ);
         }
     };
 
     template<>
     struct action<operator_lq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::LQ);
+            push_operator(p, Operator_Type::LQ);
         }
     };
 
     template<>
     struct action<operator_leq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::LEQ);
+            push_operator(p, Operator_Type::LEQ);
         }
     };
 
     template<>
     struct action<operator_eq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::EQ);
+            push_operator(p, Operator_Type::EQ);
         }
     };
 
     template<>
     struct action<operator_inc> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::INC);
+            push_operator(p, Operator_Type::INC);
         }
     };
 
     template<>
     struct action<operator_dec> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::DEC);
+            push_operator(p, Operator_Type::DEC);
         }
     };
 
     template<>
     struct action<operator_sarq> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::SARQ);
+            push_operator(p, Operator_Type::SARQ);
         }
     };
 
     template<>
     struct action<operator_at> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::CISC);
+            push_operator(p, Operator_Type::CISC);
         }
     };
 
     template<>
     struct action<inst_goto> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::GOTO);
+            push_operator(p, Operator_Type::GOTO);
         }
     };
 
     template<>
     struct action<goto_label> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<inst_return> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::RETURN);
+            push_operator(p, Operator_Type::RETURN);
         }
     };
 
     template<>
     struct action<inst_call> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.clear();
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::CALL);
+            p.functions.back()->instructions.back()->operand_count = 0;
+            push_operator(p, Operator_Type::CALL);
         }
     };
 
     template<>
     struct action<inst_print> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in, RUNTIME_FUNCTION);
         }
     };
 
     template<>
     struct action<inst_array_error> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in, RUNTIME_FUNCTION);
         }
     };
 
     template<>
     struct action<inst_allocate> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in, RUNTIME_FUNCTION);
         }
     };
 
     template<>
     struct action<inst_call_number> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
     template<>
     struct action<inst_cjump> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operators.push_back(Operator_Type::CJUMP);
+            push_operator(p, Operator_Type::CJUMP);
         }
     };
 
     template<>
     struct action<inst_cjump_label> {
         static void apply(const pegtl::input &in, Program &p) {
-            p.functions.back()->instructions.back()->operands.push_back(in.string());
+            push_operand(p, in);
         }
     };
 
@@ -569,6 +668,7 @@ namespace L2 {
         pegtl::analyze<grammar>();
         Program p;
         pegtl::file_parser(fileName).parse<grammar, action>(p);
+        end_function(p.functions.back());
         return p;
     }
 
@@ -580,6 +680,7 @@ namespace L2 {
         pegtl::analyze<function_grammar>();
         Program p;
         pegtl::file_parser(file).parse<function_grammar, action>(p);
+        end_function(p.functions.back());
         return p;
     }
 
@@ -0,0 +1,166 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "L2.h"
+#include "liveness.h"
+
+using namespace std;
+
+namespace L2 {
+    inline bool ends_region(const Instruction *inst) {
+        switch (inst->operators[0]) {
+            case Operator_Type::LABEL:
+            case Operator_Type::CJUMP:
+            case Operator_Type::GOTO:
+            case Operator_Type::RETURN:
+            case Operator_Type::CALL:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    inline bool accesses_memory(const Instruction *inst) {
+        return mem_operand_index(inst) != -1 || inst->operators[0] == Operator_Type::MEM_INDEX ||
+               (inst->operator_count == 2 && (inst->operators[1] == Operator_Type::STACK_ARG ||
+                                                inst->operators[1] == Operator_Type::MEM_INDEX));
+    }
+
+    inline bool intersects(const Live_Bits &live, const vector<uint64_t> &a, int i, const vector<uint64_t> &b, int j) {
+        for (int w = 0; w < live.words; w++) {
+            if (a[i * live.words + w] & b[j * live.words + w]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void step_up(const Live_Bits &bits, int i, vector<uint64_t> &live, int &count) {
+        /*
+         * Moves the live set from below instruction i to above it.
+         * */
+        for (int w = 0; w < bits.words; w++) {
+            uint64_t next = (live[w] & ~bits.kill[i * bits.words + w]) | bits.gen[i * bits.words + w];
+            count += __builtin_popcountll(next) - __builtin_popcountll(live[w]);
+            live[w] = next;
+        }
+    }
+
+    inline bool writes_memory(const Instruction *inst) {
+        return inst->operators[0] == Operator_Type::MEM || inst->operators[0] == Operator_Type::MEM_INDEX;
+    }
+
+    pair<int, int> pressure(const vector<int> &order, const Live_Bits &bits, const vector<uint64_t> &live_out) {
+        /*
+         * Largest and total number of values live across the instructions of order.
+         * */
+        vector<uint64_t> live = live_out;
+        int count = 0;
+        for (auto w : live) {
+            count += __builtin_popcountll(w);
+        }
+        int largest = count, total = 0;
+        for (int i = order.size() - 1; i >= 0; i--) {
+            step_up(bits, order[i], live, count);
+            largest = max(largest, count);
+            total += count;
+        }
+        return make_pair(largest, total);
+    }
+
+    void schedule_region(Function *f, int begin, int end, const Live_Bits &bits, const vector<uint64_t> &live_out) {
+        /*
+         * Bottom-up greedy list scheduling of instructions [begin, end). Starting from the
+         * values live out of the region, the instruction placed next (going upwards) is
+         * the one among those whose dependents are all placed that ends the most live
+         * ranges and starts the fewest, ties keep the original order. The new order is only
+         * kept if it lowers the peak, then the total, number of values live at once.
+         * */
+        int n = end - begin;
+        vector<vector<int>> succ(n);
+        for (int a = 0; a < n; a++) {
+            Instruction *first = f->instructions[begin + a];
+            for (int b = a + 1; b < n; b++) {
+                Instruction *second = f->instructions[begin + b];
+                bool memory = accesses_memory(first) && accesses_memory(second) &&
+                              (writes_memory(first) || writes_memory(second));
+                if (memory || intersects(bits, bits.kill, begin + a, bits.gen, begin + b) ||
+                        intersects(bits, bits.gen, begin + a, bits.kill, begin + b) ||
+                        intersects(bits, bits.kill, begin + a, bits.kill, begin + b)) {
+                    succ[a].push_back(b);
+                }
+            }
+        }
+
+        vector<int> pending_succs(n, 0);
+        vector<vector<int>> pred(n);
+        for (int a = 0; a < n; a++) {
+            for (auto const &b : succ[a]) {
+                pred[b].push_back(a);
+                pending_succs[a]++;
+            }
+        }
+        vector<uint64_t> live = live_out;
+        int count = 0;
+        vector<int> order(n);
+        vector<bool> scheduled(n, false);
+        for (int step = n - 1; step >= 0; step--) {
+            int best = -1, best_score = 0;
+            for (int a = n - 1; a >= 0; a--) {
+                if (scheduled[a] || pending_succs[a] > 0) {
+                    continue;
+                }
+                int score = 0;
+                for (int w = 0; w < bits.words; w++) {
+                    uint64_t gen = bits.gen[(begin + a) * bits.words + w], kill = bits.kill[(begin + a) * bits.words + w];
+                    score += __builtin_popcountll(gen & ~live[w]) - __builtin_popcountll(kill & live[w] & ~gen);
+                }
+                if (best == -1 || score < best_score) {
+                    best = a;
+                    best_score = score;
+                }
+            }
+            scheduled[best] = true;
+            order[step] = begin + best;
+            step_up(bits, begin + best, live, count);
+            for (auto const &b : pred[best]) {
+                pending_succs[b]--;
+            }
+        }
+        vector<int> original;
+        for (int a = 0; a < n; a++) {
+            original.push_back(begin + a);
+        }
+        if (pressure(order, bits, live_out) >= pressure(original, bits, live_out)) {
+            return;
+        }
+        vector<Instruction *> instructions;
+        for (auto const &i : order) {
+            instructions.push_back(f->instructions[i]);
+        }
+        for (int a = 0; a < n; a++) {
+            f->instructions[begin + a] = instructions[a];
+        }
+    }
+
+    void schedule_blocks(Function *f) {
+        Live_Bits bits = live_analysis(f);
+        int n = f->instructions.size();
+        int begin = 0;
+        for (int i = 0; i <= n; i++) {
+            if (i < n && !ends_region(f->instructions[i])) {
+                continue;
+            }
+            if (i - begin > 1) {
+                vector<uint64_t> live_out(bits.words, 0);
+                if (i < n) {
+                    copy(bits.in.begin() + i * bits.words, bits.in.begin() + (i + 1) * bits.words, live_out.begin());
+                }
+                schedule_region(f, begin, i, bits, live_out);
+            }
+            begin = i + 1;
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include "L2.h"
+
+using namespace std;
+
+namespace L2 {
+    inline bool is_slot(const Operand &base, const Operand &offset, int64_t spilled) {
+        return base == make_register(rsp_id) && offset.value >= 0 && offset.value < spilled * 8;
+    }
+
+    bool uses_rsp_as_value(const Instruction *inst) {
+        /*
+         * Every operand equal to rsp that is not the base of a memory access.
+         * */
+        for (int i = 0; i < inst->operand_count; i++) {
+            if (inst->operands[i] != make_register(rsp_id)) {
+                continue;
+            }
+            if (i != mem_operand_index(inst)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void color_stack_slots(Function *f, int64_t original_locals) {
+        /*
+         * The spiller gives every spilled variable its own slot at the bottom of the frame,
+         * in [0, 8 * spilled). Slots are treated like variables: a store defines one, a load
+         * uses one, and two slots interfere if one is defined while the other is live.
+         * Slots that never interfere are then merged, and everything above them is moved
+         * down by the same amount.
+         * */
+        int64_t spilled = f->locals - original_locals;
+        int n = f->instructions.size();
+        if (spilled <= 1) {
+            return;
+        }
+        for (auto const &inst : f->instructions) {
+            if (uses_rsp_as_value(inst)) {
+                return;
+            }
+        }
+
+        vector<set<int64_t>> gen(n), kill(n), in(n), out(n);
+        vector<int> labels(f->labels.size(), 0);
+        for (int i = 0; i < n; i++) {
+            Instruction *inst = f->instructions[i];
+            int idx = mem_operand_index(inst);
+            if (idx != -1 && is_slot(inst->operands[idx], inst->operands[idx + 1], spilled)) {
+                int64_t slot = inst->operands[idx + 1].value / 8;
+                if (inst->operators[0] == Operator_Type::MEM && inst->operators[1] == Operator_Type::MOVQ) {
+                    kill[i].insert(slot);
+                } else {
+                    gen[i].insert(slot);
+                }
+            } else if (inst->operators[0] == Operator_Type::LABEL) {
+                labels[inst->operands[0].id] = i;
+            }
+        }
+
+        bool flag = true;
+        while (flag) {
+            flag = false;
+            for (int i = n - 1; i >= 0; i--) {
+                Instruction *inst = f->instructions[i];
+                set<int64_t> out_tmp, in_tmp;
+                switch (inst->operators[0]) {
+                    case Operator_Type::CJUMP: {
+                        const set<int64_t> &taken = in[labels[inst->operands[inst->operand_count - 1].id]];
+                        out_tmp = in[labels[inst->operands[inst->operand_count - 2].id]];
+                        out_tmp.insert(taken.begin(), taken.end());
+                        break;
+                    }
+                    case Operator_Type::GOTO:
+                        out_tmp = in[labels[inst->operands[0].id]];
+                        break;
+                    case Operator_Type::RETURN:
+                        break;
+                    default:
+                        if (i < n - 1) {
+                            out_tmp = in[i + 1];
+                        }
+                        break;
+                }
+                if (out_tmp != out[i]) {
+                    out[i] = out_tmp;
+                    flag = true;
+                }
+                for (auto x : out[i]) {
+                    if (kill[i].count(x) == 0) {
+                        in_tmp.insert(x);
+                    }
+                }
+                in_tmp.insert(gen[i].begin(), gen[i].end());
+                if (in_tmp != in[i]) {
+                    in[i] = in_tmp;
+                    flag = true;
+                }
+            }
+        }
+
+        vector<set<int64_t>> graph(spilled);
+        for (int i = 0; i < n; i++) {
+            for (auto const &k : kill[i]) {
+                for (auto const &o : out[i]) {
+                    if (k != o) {
+                        graph[k].insert(o);
+                        graph[o].insert(k);
+                    }
+                }
+            }
+        }
+
+        vector<int64_t> color(spilled, -1);
+        int64_t colors = 0;
+        for (int64_t slot = 0; slot < spilled; slot++) {
+            set<int64_t> adjacent_colors;
+            for (auto const &other : graph[slot]) {
+                if (color[other] != -1) {
+                    adjacent_colors.insert(color[other]);
+                }
+            }
+            while (adjacent_colors.count(++color[slot]) > 0);
+            colors = max(colors, color[slot] + 1);
+        }
+        if (colors == spilled) {
+            return;
+        }
+
+        for (auto const &inst : f->instructions) {
+            int idx = mem_operand_index(inst);
+            if (idx == -1 || inst->operands[idx] != make_register(rsp_id) || inst->operands[++idx].value < 0) {
+                continue;
+            }
+            int64_t offset = inst->operands[idx].value;
+            inst->operands[idx].value = offset < spilled * 8 ? color[offset / 8] * 8 + offset % 8
+                                                             : offset - (spilled - colors) * 8;
+        }
+        f->locals = original_locals + colors;
+    }
+}
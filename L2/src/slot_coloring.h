@@ -0,0 +1,9 @@
+#pragma once
+
+#include "L2.h"
+
+using namespace std;
+
+namespace L2 {
+    void color_stack_slots(Function *f, int64_t original_locals);
+}
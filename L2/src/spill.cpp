@@ -1,103 +1,304 @@
-#include <map>
-#include <set>
 #include <string>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 
 #include "L2.h"
+#include "liveness.h"
+#include "callee_save.h"
+#include "spill.h"
 
 using namespace std;
 
 namespace L2 {
-    void replace(const Function *f, const map<string, string> &reg_map) {
+    void replace(const Function *f, const vector<int32_t> &colors) {
         for (auto const &inst : f->instructions) {
-            for (int i = 0; i < inst->operands.size(); i++) {
-                if (reg_map.find(inst->operands[i]) != reg_map.end()) {
-                    inst->operands[i] = reg_map.at(inst->operands[i]);
+            for (int i = 0; i < inst->operand_count; i++) {
+                Operand &o = inst->operands[i];
+                if (o.kind == VARIABLE && colors[o.id] != -1) {
+                    o = make_register(colors[o.id]);
                 }
             }
         }
     }
 
-    void transform_instruction(Function *func, const Instruction *inst, const string &sp, int64_t &index) {
+    const Operand stack_pointer = make_register(rsp_id);
+
+    bool fold_spill_slot(const Instruction *inst, const Operand &sp, Instruction *nInst) {
+        /*
+         * Rewrites inst, in which sp appears once, so that it accesses the spill slot
+         * (mem rsp 0) directly, whenever x86 accepts a memory operand in that position.
+         * Returns false if inst needs a temporary instead.
+         * */
+        const Operator_Type *ops = inst->operators;
+        const Operand *opds = inst->operands;
+        Operator_Type op = ops[0];
+        if (inst->operator_count == 1) {
+            switch (op) {
+                case Operator_Type::MOVQ:
+                case Operator_Type::ADDQ:
+                case Operator_Type::SUBQ:
+                case Operator_Type::ANDQ:
+                case Operator_Type::IMULQ:
+                case Operator_Type::SALQ:
+                case Operator_Type::SARQ:
+                    if (opds[0] == sp && op != Operator_Type::IMULQ) {
+                        return set_instruction(nInst, {Operator_Type::MEM, op}, {stack_pointer, make_number(0), opds[1]});
+                    } else if (opds[1] == sp && op != Operator_Type::SALQ && op != Operator_Type::SARQ) {
+                        return set_instruction(nInst, {op, Operator_Type::MEM}, {opds[0], stack_pointer, make_number(0)});
+                    }
+                    return false;
+                case Operator_Type::INC:
+                case Operator_Type::DEC:
+                    return set_instruction(nInst, {Operator_Type::MEM, op}, {stack_pointer, make_number(0)});
+                default:
+                    return false;
+            }
+        } else if (inst->operator_count == 2 && op == Operator_Type::MOVQ && (ops[1] == Operator_Type::LQ ||
+                ops[1] == Operator_Type::LEQ || ops[1] == Operator_Type::EQ) && opds[0] != sp) {
+            if (opds[1] == sp) {
+                return set_instruction(nInst, {Operator_Type::MOVQ, Operator_Type::MEM, ops[1]},
+                                              {opds[0], stack_pointer, make_number(0), opds[2]});
+            } else {
+                return set_instruction(nInst, {Operator_Type::MOVQ, ops[1], Operator_Type::MEM},
+                                              {opds[0], opds[1], stack_pointer, make_number(0)});
+            }
+        } else if (inst->operator_count == 2 && op == Operator_Type::CJUMP) {
+            if (opds[0] == sp) {
+                return set_instruction(nInst, {Operator_Type::CJUMP, Operator_Type::MEM, ops[1]},
+                                              {stack_pointer, make_number(0), opds[1], opds[2], opds[3]});
+            } else {
+                return set_instruction(nInst, {Operator_Type::CJUMP, ops[1], Operator_Type::MEM},
+                                              {opds[0], stack_pointer, make_number(0), opds[2], opds[3]});
+            }
+        }
+        return false;
+    }
+
+    void transform_instruction(Function *func, const Instruction *inst, const Operand &sp, int64_t &index) {
         int matched_num = 0;
         Instruction *nInst = new Instruction;
-        for (auto const &op : inst->operands) {
-            if (op == sp) {
+        for (int i = 0; i < inst->operand_count; i++) {
+            if (inst->operands[i] == sp) {
                 matched_num++;
             }
         }
         if (matched_num > 0) {
-            if (matched_num == 1 && inst->operators.size() == 1 && (inst->operators[0] == Operator_Type::MOVQ ||
-                    inst->operators[0] == Operator_Type::ADDQ|| inst->operators[0] == Operator_Type::SUBQ)) {
-                if (inst->operands[0] == sp) {
-                    nInst->operators = {Operator_Type::MEM, inst->operators[0]};
-                    nInst->operands = {"rsp", "0", inst->operands[1]};
-                } else {
-                    nInst->operators = {inst->operators[0], Operator_Type::MEM};
-                    nInst->operands = {inst->operands[0], "rsp", "0"};
-                }
+            if (matched_num == 1 && fold_spill_slot(inst, sp, nInst)) {
+                nInst->mark = inst->mark;
                 func->instructions.push_back(nInst);
             } else {
-                string nv = sp + "_nv_" + to_string(++index);
+                Operand nv = new_variable(func, func->names[sp.id] + "_nv_" + to_string(++index));
                 if (!(matched_num == 1 && inst->operators[0] == Operator_Type::MOVQ && inst->operands[0] == sp)) {
-                    Instruction *preInst = new Instruction;
-                    preInst->operators = {Operator_Type::MOVQ, Operator_Type::MEM};
-                    preInst->operands = {nv, "rsp", "0"};
-                    func->instructions.push_back(preInst);
+                    func->instructions.push_back(new_instruction({Operator_Type::MOVQ, Operator_Type::MEM},
+                                                                 {nv, stack_pointer, make_number(0)}));
                 }
-                Instruction *midInst = new Instruction;
-                midInst->operators = inst->operators;
-                midInst->operands = inst->operands;
-                for (int i = 0; i < midInst->operands.size(); i++) {
+                Instruction *midInst = new Instruction(*inst);
+                for (int i = 0; i < midInst->operand_count; i++) {
                     if (midInst->operands[i] == sp) {
                         midInst->operands[i] = nv;
                     }
                 }
                 func->instructions.push_back(midInst);
-                if (inst->operators[0] != Operator_Type::CJUMP && (inst->operands[0] == sp && inst->operators[0] != Operator_Type::MEM) &&
+                if (inst->operators[0] != Operator_Type::CJUMP && (inst->operands[0] == sp && inst->operators[0] != Operator_Type::MEM &&
+                    inst->operators[0] != Operator_Type::MEM_INDEX) &&
                     !(inst->operators[0] == Operator_Type::CALL && inst->operands[0] == sp)) {
-                    Instruction *postInst = new Instruction;
-                    postInst->operators = {Operator_Type::MEM, Operator_Type::MOVQ};
-                    postInst->operands = {"rsp", "0", nv};
-                    func->instructions.push_back(postInst);
+                    func->instructions.push_back(new_instruction({Operator_Type::MEM, Operator_Type::MOVQ},
+                                                                 {stack_pointer, make_number(0), nv}));
                 }
             }
         } else {
-            nInst->operands = inst->operands;
-            nInst->operators = inst->operators;
+            *nInst = *inst;
             func->instructions.push_back(nInst);
         }
     }
 
-    Function *spill(const Function *f, const string &sp) {
+    void shift_stack_slots(const Function *f) {
+        for (auto const &inst : f->instructions) {
+            int offset = frame_offset_index(inst);
+            if (offset != -1 && inst->operands[offset].value >= 0) {
+                inst->operands[offset].value += 8;
+            }
+        }
+    }
+
+    Function *spill(Function *f, int32_t sp) {
         int64_t index = 0;
-        Function *func = new Function;
-        func->name = f->name;
-        func->arguments = f->arguments;
+        Function *func = empty_copy(f);
         func->locals = f->locals + 1;
+        shift_stack_slots(f);
+        Operand variable = {VARIABLE, sp, 0};
+        for (auto const &inst : f->instructions) {
+            transform_instruction(func, inst, variable, index);
+        }
+        return func;
+    }
+
+    inline bool is_runtime_call(const Instruction *inst) {
+        return inst->operands[0].kind == RUNTIME_FUNCTION;
+    }
+
+    Function *split_around_calls(Function *f, int32_t sp) {
+        /*
+         * Instead of spilling sp everywhere, keep it in a register between calls and only
+         * park it in a stack slot across every call it survives. For calls to L2 functions
+         * the reload goes right after the return label, so it is only done when that label
+         * is not a jump target, and only when the stores and reloads are cheaper than a
+         * full spill.
+         * Returns NULL if splitting is not worthwhile.
+         * */
+        Live_Bits live = live_analysis(f);
+        Operand variable = {VARIABLE, sp, 0};
+        auto live_after = [&](int i) {
+            return live.test(live.out, i, sp);
+        };
+        vector<bool> jump_targets(f->labels.size(), false);
         for (auto const &inst : f->instructions) {
-            if (inst->operators[0] == Operator_Type::MEM && inst->operands[0] == "rsp") {
-                if (stoll(inst->operands[1]) >= 0) {
-                    inst->operands[1] = to_string(stoll(inst->operands[1]) + 8);
+            if (inst->operators[0] == Operator_Type::GOTO) {
+                jump_targets[inst->operands[0].id] = true;
+            } else if (inst->operators[0] == Operator_Type::CJUMP) {
+                jump_targets[inst->operands[inst->operand_count - 2].id] = true;
+                jump_targets[inst->operands[inst->operand_count - 1].id] = true;
+            }
+        }
+        int64_t crossed_calls = 0, uses = 0;
+        for (int i = 0; i < f->instructions.size(); i++) {
+            Instruction *inst = f->instructions[i];
+            if (uses_operand(inst, variable)) {
+                uses++;
+            }
+            if (inst->operators[0] == Operator_Type::CALL && live_after(i)) {
+                crossed_calls++;
+                if (!is_runtime_call(inst) && i + 1 < f->instructions.size() &&
+                        f->instructions[i + 1]->operators[0] == Operator_Type::LABEL &&
+                        jump_targets[f->instructions[i + 1]->operands[0].id]) {
+                    return NULL;
                 }
-            } else if (inst->operators.size() == 2 && inst->operators[1] == Operator_Type::MEM && inst->operands[1] == "rsp") {
-                if (stoll(inst->operands[2]) >= 0) {
-                    inst->operands[2] = to_string(stoll(inst->operands[2]) + 8);
+            }
+        }
+        if (crossed_calls == 0 || 2 * crossed_calls >= uses) {
+            return NULL;
+        }
+
+        Function *func = empty_copy(f);
+        func->locals = f->locals + 1;
+        shift_stack_slots(f);
+        for (int i = 0; i < f->instructions.size(); i++) {
+            Instruction *inst = f->instructions[i];
+            bool crossing = inst->operators[0] == Operator_Type::CALL && live_after(i);
+            if (crossing) {
+                func->instructions.push_back(new_instruction({Operator_Type::MEM, Operator_Type::MOVQ},
+                                                             {stack_pointer, make_number(0), variable}));
+            }
+            func->instructions.push_back(new Instruction(*inst));
+            if (crossing) {
+                if (!is_runtime_call(inst) && i + 1 < f->instructions.size() &&
+                        f->instructions[i + 1]->operators[0] == Operator_Type::LABEL) {
+                    func->instructions.push_back(new Instruction(*f->instructions[i + 1]));
+                    i++;
                 }
+                func->instructions.push_back(new_instruction({Operator_Type::MOVQ, Operator_Type::MEM},
+                                                             {variable, stack_pointer, make_number(0)}));
+            }
+        }
+        return func;
+    }
+
+    vector<Operand> rematerializable_variables(const Function *f) {
+        /*
+         * A variable is rematerializable if it is defined exactly once in the function,
+         * and that definition is a plain move of a number or a label into it.
+         * */
+        Live_Bits live = live_analysis(f);
+        vector<int> def_count(f->names.size(), 0);
+        vector<Operand> remat(f->names.size(), Operand{NO_OPERAND, -1, 0});
+        for (int i = 0; i < f->instructions.size(); i++) {
+            Instruction *inst = f->instructions[i];
+            for (int32_t k : set_bits(live.kill, i, live.words)) {
+                def_count[k]++;
+            }
+            if (inst->operator_count == 1 && inst->operators[0] == Operator_Type::MOVQ &&
+                    inst->operands[0].kind == VARIABLE && !is_spill_temporary(f->names[inst->operands[0].id]) &&
+                    (inst->operands[1].kind == NUMBER || inst->operands[1].kind == LABEL_NAME)) {
+                remat[inst->operands[0].id] = inst->operands[1];
             }
         }
+        for (int32_t id = 0; id < remat.size(); id++) {
+            if (def_count[id] != 1) {
+                remat[id].kind = NO_OPERAND;
+            }
+        }
+        return remat;
+    }
+
+    Function *rematerialize(const Function *f, const vector<Operand> &remat) {
+        /*
+         * Drops the definition of every rematerializable variable and re-emits it right
+         * before each use, into a temporary that lives for that one instruction. These
+         * variables never get a node in the interference graph, so they neither need a
+         * register across their live range nor make their neighbors look harder to color.
+         * */
+        bool any = false;
+        for (auto const &value : remat) {
+            any = any || value.kind != NO_OPERAND;
+        }
+        if (!any) {
+            return const_cast<Function *>(f);
+        }
+        auto is_remat = [&remat](const Operand &o) {
+            return o.kind == VARIABLE && o.id < remat.size() && remat[o.id].kind != NO_OPERAND;
+        };
+        vector<int64_t> index(f->names.size(), 0);
+        Function *func = empty_copy(f);
         for (auto const &inst : f->instructions) {
-            transform_instruction(func, inst, sp, index);
+            const Operand *opds = inst->operands;
+            bool move = inst->operator_count == 1 && inst->operators[0] == Operator_Type::MOVQ;
+            if (move && is_remat(opds[0])) {
+                continue;
+            }
+            Instruction *nInst = new Instruction(*inst);
+            if (move && is_remat(opds[1])) {
+                nInst->operands[1] = remat[opds[1].id];
+                func->instructions.push_back(nInst);
+                continue;
+            }
+            for (int i = 0; i < nInst->operand_count; i++) {
+                Operand o = nInst->operands[i];
+                if (!is_remat(o)) {
+                    continue;
+                }
+                Operand nv = new_variable(func, func->names[o.id] + "_nv_" + to_string(++index[o.id]));
+                func->instructions.push_back(new_instruction({Operator_Type::MOVQ}, {nv, remat[o.id]}));
+                for (int j = i; j < nInst->operand_count; j++) {
+                    if (nInst->operands[j] == o) {
+                        nInst->operands[j] = nv;
+                    }
+                }
+            }
+            func->instructions.push_back(nInst);
         }
         return func;
     }
 
-    Function *replace_and_spill(Function *f, const map<string, string> &reg_map, const set<string> &spill_set) {
-        replace(f, reg_map);
+    Function *replace_and_spill(Function *f, const vector<int32_t> &colors, const vector<int32_t> &spill_set,
+                                const vector<bool> &call_crossing) {
+        /*
+         * Colors are only committed once nothing spills. Fixing them earlier could leave a
+         * temporary that has to be in rcx with no way to get it.
+         * */
+        if (spill_set.empty()) {
+            replace(f, colors);
+        }
         for (auto const &sp : spill_set) {
-            f = spill(f, sp);
+            Function *split = NULL;
+            if (call_crossing[sp] && callee_save_register(f, sp) == -1 &&
+                    (split = split_around_calls(f, sp)) != NULL) {
+                f = split;
+            } else {
+                f = spill(f, sp);
+            }
         }
         return f;
     }
 
-}
\ No newline at end of file
+}
@@ -1,13 +1,27 @@
 #pragma once
 
-#include <map>
-#include <set>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 #include "L2.h"
 
 using namespace std;
 
 namespace L2 {
-    Function *replace_and_spill(Function *f, const map<string, string> &reg_map, const set<string> &spill);
-}
\ No newline at end of file
+    inline bool is_spill_temporary(const string &var) {
+        return var.find("_nv_") != string::npos;
+    }
+
+    Function *spill(Function *f, int32_t sp);
+
+    /*
+     * The constant every rematerializable variable id holds, NO_OPERAND for the others.
+     * */
+    vector<Operand> rematerializable_variables(const Function *f);
+
+    Function *rematerialize(const Function *f, const vector<Operand> &remat);
+
+    Function *replace_and_spill(Function *f, const vector<int32_t> &colors, const vector<int32_t> &spill,
+                                const vector<bool> &call_crossing);
+}
@@ -0,0 +1,118 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <unordered_set>
+#include <algorithm>
+
+#include "L2.h"
+#include "liveness.h"
+#include "callee_save.h"
+
+using namespace std;
+
+namespace L2 {
+    int find_root(vector<int> &parent, int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void rename_webs(Function *f) {
+        /*
+         * A web is a set of definitions and uses of a variable that are connected through
+         * the values flowing between them. IR lowering reuses the same temporary names for
+         * every array access of a function, so one name often covers many unrelated webs
+         * that would otherwise be allocated as a single long live range.
+         *
+         * Every value of a variable live into an instruction and every definition gets a
+         * node, and nodes are merged along the control flow edges the value is live on.
+         * The first web of a variable keeps its name, the others get fresh ones.
+         * */
+        Live_Bits live = live_analysis(f);
+        vector<vector<int>> succ = successors(f);
+        int n = f->instructions.size();
+
+        /*
+         * The nodes of the values live into instruction i are numbered from in_base[i] on,
+         * in the order of the variable ids in live_in[i].
+         * */
+        vector<vector<int32_t>> live_in(n);
+        vector<int> in_base(n), def_node(n, -1);
+        vector<int> parent;
+        auto in_node = [&](int i, int32_t id) {
+            auto it = lower_bound(live_in[i].begin(), live_in[i].end(), id);
+            return it != live_in[i].end() && *it == id ? in_base[i] + (int)(it - live_in[i].begin()) : -1;
+        };
+        unordered_set<uint32_t> names;
+        for (auto const &name : f->names) {
+            names.insert(name.id());
+        }
+        for (int i = 0; i < n; i++) {
+            const Instruction *inst = f->instructions[i];
+            in_base[i] = parent.size();
+            for (int32_t id : set_bits(live.in, i, live.words)) {
+                if (id >= register_count) {
+                    live_in[i].push_back(id);
+                    parent.push_back(parent.size());
+                }
+            }
+            if (writes_first_operand(inst) && inst->operands[0].kind == VARIABLE) {
+                def_node[i] = parent.size();
+                parent.push_back(parent.size());
+                int from = in_node(i, inst->operands[0].id);
+                if (reads_first_operand(inst) && from != -1) {
+                    parent[find_root(parent, def_node[i])] = find_root(parent, from);
+                }
+            }
+        }
+
+        for (int i = 0; i < n; i++) {
+            for (int32_t id : set_bits(live.out, i, live.words)) {
+                if (id < register_count) {
+                    continue;
+                }
+                int from = def_node[i] != -1 && f->instructions[i]->operands[0].id == id ? def_node[i] : in_node(i, id);
+                for (auto const &s : succ[i]) {
+                    int to = in_node(s, id);
+                    if (to != -1) {
+                        parent[find_root(parent, to)] = find_root(parent, from);
+                    }
+                }
+            }
+        }
+
+        vector<int> web_name(parent.size(), -1), webs_per_variable(f->names.size(), 0);
+        vector<Operand> web_names;
+        for (int i = 0; i < n; i++) {
+            Instruction *inst = f->instructions[i];
+            for (int j = 0; j < inst->operand_count; j++) {
+                const Operand o = inst->operands[j];
+                if (o.kind != VARIABLE) {
+                    continue;
+                }
+                int node = j == 0 && def_node[i] != -1 ? def_node[i] : in_node(i, o.id);
+                if (node == -1) {
+                    continue;
+                }
+                node = find_root(parent, node);
+                if (web_name[node] == -1) {
+                    Operand web = o;
+                    if (webs_per_variable[o.id]++ > 0) {
+                        symbol::Symbol name;
+                        do {
+                            name = f->names[o.id] + "_web" + to_string(webs_per_variable[o.id]++);
+                        } while (names.count(name.id()) > 0);
+                        names.insert(name.id());
+                        web = new_variable(f, name);
+                    }
+                    web_name[node] = web_names.size();
+                    web_names.push_back(web);
+                }
+                inst->operands[j] = web_names[web_name[node]];
+            }
+        }
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "L2.h"
+
+using namespace std;
+
+namespace L2 {
+    void rename_webs(Function *f);
+}
@@ -0,0 +1,77 @@
+#!/bin/bash
+#
+# Run time of call-heavy recursive programs with calls lowered to a stored return label
+# plus jmp (NATIVE_CALLS=0) and to call/ret (NATIVE_CALLS=1).
+#
+# usage: ./scripts/benchmark_calls.sh [N]
+
+n=${1:-32} ;
+dir=$(mktemp -d) ;
+
+cat > ${dir}/fib.L3 <<FIB
+define :main ( ) {
+  r <- call :fib(${n})
+  r <- r << 1
+  r <- r + 1
+  call print(r)
+  return
+}
+
+define :fib (n) {
+  small <- n < 2
+  br small :base :recurse
+  :base
+  return n
+  :recurse
+  a <- n - 1
+  x <- call :fib(a)
+  b <- n - 2
+  y <- call :fib(b)
+  z <- x + y
+  return z
+}
+FIB
+
+cat > ${dir}/ackermann.L3 <<ACK
+define :main ( ) {
+  r <- call :ack(2, ${n}00)
+  r <- r << 1
+  r <- r + 1
+  call print(r)
+  return
+}
+
+define :ack (m, n) {
+  mz <- m = 0
+  br mz :m_zero :m_pos
+  :m_zero
+  r <- n + 1
+  return r
+  :m_pos
+  nz <- n = 0
+  br nz :n_zero :n_pos
+  :n_zero
+  m1 <- m - 1
+  r <- call :ack(m1, 1)
+  return r
+  :n_pos
+  n1 <- n - 1
+  inner <- call :ack(m, n1)
+  m1 <- m - 1
+  r <- call :ack(m1, inner)
+  return r
+}
+ACK
+
+for program in fib ackermann ; do
+  for native in 0 1 ; do
+    rm -f a.out ;
+    NATIVE_CALLS=${native} ./L3c ${dir}/${program}.L3 > /dev/null 2>&1 ;
+    start=$(date +%s.%N) ;
+    result=$(./a.out) ;
+    end=$(date +%s.%N) ;
+    echo "${program} NATIVE_CALLS=${native}: ${result} in $(awk "BEGIN { printf \"%.3f\", $end - $start }") s" ;
+  done
+done
+rm -f a.out ;
+rm -rf ${dir} ;
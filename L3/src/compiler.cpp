@@ -1,4 +1,5 @@
 #include <unistd.h>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -6,6 +7,7 @@
 
 #include "l3.h"
 #include "parser.h"
+#include "inline.h"
 
 
 using namespace L3;
@@ -13,31 +15,48 @@ using namespace std;
 
 
 int main(int argc, char **argv) {
-    bool verbose;
+    bool verbose = false;
+    int inline_size = defaultCalleeSize, caller_size = defaultCallerSize;
 
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " SOURCE [-v]" << endl;
+        cerr << "Usage: " << argv[0] << " SOURCE [-v] [-i INLINE_SIZE] [-c CALLER_SIZE]" << endl;
         return 1;
     }
     int32_t opt;
-    while ((opt = getopt(argc, argv, "v")) != -1) {
+    while ((opt = getopt(argc, argv, "vi:c:")) != -1) {
         switch (opt) {
             case 'v':
                 verbose = true;
                 break;
+            case 'i':
+                inline_size = atoi(optarg);
+                break;
+            case 'c':
+                caller_size = atoi(optarg);
+                break;
             default:
-                cerr << "Usage: " << argv[0] << "[-v] SOURCE" << endl;
+                cerr << "Usage: " << argv[0] << "[-v] [-i INLINE_SIZE] [-c CALLER_SIZE] SOURCE" << endl;
                 return 1;
         }
     }
 
+    nativeCalls = getenv("NATIVE_CALLS") != NULL && string(getenv("NATIVE_CALLS")) == "1";
+
     ofstream output;
     output.open("prog.L2");
     Program p = L3ParseFile(argv[optind]);
+
+    /*
+     * Calls to functions of about INLINE_SIZE instructions are inlined while the caller
+     * stays below CALLER_SIZE instructions, -i 0 turns inlining off. With -v every inlined
+     * call site is reported.
+     * */
+    inlineCalls(p, inline_size, caller_size, verbose ? &cerr : NULL);
     vector <string> l2 = p.toL2();
     for (auto const &s : l2) {
         output << s << endl;
     }
     output.close();
+    arena::report("L3");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,252 @@
+#include <vector>
+#include <string>
+#include <set>
+#include <map>
+#include <ostream>
+
+#include "inline.h"
+
+
+using namespace std;
+
+namespace L3 {
+    /*
+     * Names of one inlined copy of a function. Variables and the labels the function
+     * defines get the prefix baseN_, where no name of the program starts with base, so
+     * they collide neither with the caller nor with another copy. Function names and
+     * numbers stay as they are.
+     * */
+    struct Renamer {
+        string prefix;
+        set<string> labels;
+
+        string operator()(const string &name) const {
+            if (name.empty() || isNumberName(name) || isRuntimeFunction(name)) {
+                return name;
+            }
+            if (name[0] == ':') {
+                return labels.count(name) > 0 ? ":" + prefix + name.substr(1) : name;
+            }
+            return prefix + name;
+        }
+    };
+
+    Instruction *copyInstruction(Instruction *inst, const Renamer &rename) {
+        if (AssignInst *i = dynamic_cast<AssignInst *>(inst)) {
+            AssignInst *copy = new AssignInst;
+            copy->var = rename(i->var), copy->s = rename(i->s);
+            return copy;
+        } else if (AssignOpInst *i = dynamic_cast<AssignOpInst *>(inst)) {
+            AssignOpInst *copy = new AssignOpInst;
+            copy->var = rename(i->var), copy->lt = rename(i->lt), copy->rt = rename(i->rt), copy->op = i->op;
+            return copy;
+        } else if (AssignCmpInst *i = dynamic_cast<AssignCmpInst *>(inst)) {
+            AssignCmpInst *copy = new AssignCmpInst;
+            copy->var = rename(i->var), copy->lt = rename(i->lt), copy->rt = rename(i->rt), copy->cmp = i->cmp;
+            return copy;
+        } else if (LoadInst *i = dynamic_cast<LoadInst *>(inst)) {
+            LoadInst *copy = new LoadInst;
+            copy->lvar = rename(i->lvar), copy->rvar = rename(i->rvar);
+            return copy;
+        } else if (StoreInst *i = dynamic_cast<StoreInst *>(inst)) {
+            StoreInst *copy = new StoreInst;
+            copy->var = rename(i->var), copy->s = rename(i->s);
+            return copy;
+        } else if (BranchInst *i = dynamic_cast<BranchInst *>(inst)) {
+            BranchInst *copy = new BranchInst;
+            copy->var = rename(i->var), copy->llabel = rename(i->llabel), copy->rlabel = rename(i->rlabel);
+            return copy;
+        } else if (LabelInst *i = dynamic_cast<LabelInst *>(inst)) {
+            LabelInst *copy = new LabelInst;
+            copy->label = rename(i->label);
+            return copy;
+        } else if (AssignCallInst *i = dynamic_cast<AssignCallInst *>(inst)) {
+            AssignCallInst *copy = new AssignCallInst;
+            copy->var = rename(i->var), copy->callee = rename(i->callee);
+            for (auto const &arg : i->args) {
+                copy->args.push_back(rename(arg));
+            }
+            return copy;
+        }
+        ReturnInst *i = dynamic_cast<ReturnInst *>(inst), *copy = new ReturnInst;
+        copy->var = rename(i->var);
+        return copy;
+    }
+
+    struct Inliner {
+        map<string, Function *> functions;
+        map<Function *, int> state;
+        int calleeSize, callerSize, copies = 0;
+        string base;
+        ostream *report;
+
+        void expand(const AssignCallInst *call, Function *callee, vector<Instruction *> &code) {
+            /*
+             * Arguments go to the renamed parameters, every return becomes an assignment of
+             * the result and a branch to the label after the body.
+             * */
+            Renamer rename;
+            rename.prefix = base + to_string(++copies) + "_";
+            for (auto const &inst : callee->instructions) {
+                if (LabelInst *label = dynamic_cast<LabelInst *>(inst)) {
+                    rename.labels.insert(label->label);
+                }
+            }
+            for (int i = 0; i < callee->arguments.size(); i++) {
+                AssignInst *param = new AssignInst;
+                param->var = rename(callee->arguments[i]), param->s = call->args[i];
+                code.push_back(param);
+            }
+            LabelInst *end = new LabelInst;
+            end->label = ":" + base + to_string(copies) + "ret";
+            for (int i = 0; i < callee->instructions.size(); i++) {
+                ReturnInst *ret = dynamic_cast<ReturnInst *>(callee->instructions[i]);
+                if (ret == NULL) {
+                    code.push_back(copyInstruction(callee->instructions[i], rename));
+                    continue;
+                }
+                if (!call->var.empty() && !ret->var.empty()) {
+                    AssignInst *result = new AssignInst;
+                    result->var = call->var, result->s = rename(ret->var);
+                    code.push_back(result);
+                }
+                if (i + 1 < callee->instructions.size()) {
+                    BranchInst *br = new BranchInst;
+                    br->llabel = end->label;
+                    code.push_back(br);
+                }
+            }
+            code.push_back(end);
+        }
+
+        vector<bool> inLoops(const Function *f) {
+            /*
+             * An instruction is in a loop if it lies between a label and a later branch back
+             * to that label.
+             * */
+            map<string, int> labels;
+            vector<int> starts(f->instructions.size() + 1, 0);
+            for (int i = 0; i < f->instructions.size(); i++) {
+                if (LabelInst *label = dynamic_cast<LabelInst *>(f->instructions[i])) {
+                    labels[label->label] = i;
+                } else if (BranchInst *br = dynamic_cast<BranchInst *>(f->instructions[i])) {
+                    for (auto const &target : {br->llabel, br->rlabel}) {
+                        if (labels.count(target) > 0) {
+                            starts[labels[target]]++;
+                            starts[i + 1]--;
+                        }
+                    }
+                }
+            }
+            vector<bool> loop;
+            int open = 0;
+            for (int i = 0; i < f->instructions.size(); i++) {
+                open += starts[i];
+                loop.push_back(open > 0);
+            }
+            return loop;
+        }
+
+        int calleeLimit(const AssignCallInst *call, bool inLoop) {
+            /*
+             * A call in a loop runs more often than the rest of its caller, and a constant
+             * argument becomes an immediate in the inlined body once its copy is folded.
+             * */
+            int limit = inLoop ? 2 * calleeSize : calleeSize;
+            for (auto const &arg : call->args) {
+                if (isNumberName(arg)) {
+                    limit += calleeSize / 4;
+                }
+            }
+            return limit;
+        }
+
+        void run(Function *f) {
+            /*
+             * Callees are done before their callers, so a small callee brings along what was
+             * inlined into it. A call back into a function still in progress is recursion
+             * and stays a call.
+             * */
+            state[f] = 1;
+            for (auto const &inst : f->instructions) {
+                AssignCallInst *call = dynamic_cast<AssignCallInst *>(inst);
+                if (call != NULL && functions.count(call->callee) > 0 && state[functions[call->callee]] == 0) {
+                    run(functions[call->callee]);
+                }
+            }
+            /*
+             * The first pass picks the call sites in loops, the second gives what is left of
+             * the caller budget to the others.
+             * */
+            vector<bool> loop = inLoops(f);
+            vector<Function *> inlined(f->instructions.size(), NULL);
+            int size = f->instructions.size();
+            for (int pass = 0; pass < 2; pass++) {
+                for (int i = 0; i < f->instructions.size(); i++) {
+                    AssignCallInst *call = dynamic_cast<AssignCallInst *>(f->instructions[i]);
+                    Function *callee = call != NULL && functions.count(call->callee) > 0 ? functions[call->callee] : NULL;
+                    if (loop[i] != (pass == 0) || callee == NULL || state[callee] != 2 || call->args.size() != callee->arguments.size() ||
+                            callee->instructions.size() > calleeLimit(call, loop[i]) ||
+                            size + callee->instructions.size() + callee->arguments.size() > callerSize) {
+                        continue;
+                    }
+                    inlined[i] = callee;
+                    size += callee->instructions.size() + callee->arguments.size();
+                }
+            }
+            vector<Instruction *> code;
+            for (int i = 0; i < f->instructions.size(); i++) {
+                Function *callee = inlined[i];
+                if (callee == NULL) {
+                    code.push_back(f->instructions[i]);
+                    continue;
+                }
+                expand(dynamic_cast<AssignCallInst *>(f->instructions[i]), callee, code);
+                if (report != NULL) {
+                    *report << f->name << ": inlined " << callee->name << " (" << callee->instructions.size()
+                            << " instructions" << (loop[i] ? ", in a loop" : "") << ") as " << base << copies << "_" << endl;
+                }
+            }
+            f->instructions = code;
+            state[f] = 2;
+        }
+    };
+
+    string freeBase() {
+        /*
+         * Every name of the program was interned by the parser. A base that none of them
+         * starts with, with or without the colon of a label, leaves the renamed copies
+         * free of the names already there. The end label of a copy is baseNret, which has
+         * no _ after N and so is never a renamed label either.
+         * */
+        string base = "_inl";
+        uint32_t names = symbol::interner().size();
+        for (bool taken = true; taken; ) {
+            taken = false;
+            for (uint32_t id = 0; id < names && !taken; id++) {
+                const string &name = symbol::interner().name(id);
+                taken = name.compare(0, base.size(), base) == 0 || name.compare(0, base.size() + 1, ":" + base) == 0;
+            }
+            if (taken) {
+                base = "_" + base;
+            }
+        }
+        return base;
+    }
+
+    void inlineCalls(Program &p, int calleeSize, int callerSize, ostream *report) {
+        Inliner inliner;
+        inliner.base = freeBase();
+        inliner.calleeSize = calleeSize;
+        inliner.callerSize = callerSize;
+        inliner.report = report;
+        for (auto const &f : p.functions) {
+            inliner.functions[f->name] = f;
+        }
+        for (auto const &f : p.functions) {
+            if (inliner.state[f] == 0) {
+                inliner.run(f);
+            }
+        }
+    }
+}
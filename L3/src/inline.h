@@ -0,0 +1,25 @@
+#pragma once
+
+#include <ostream>
+
+#include "l3.h"
+
+
+using namespace std;
+
+namespace L3 {
+    /*
+     * Defaults of the -i and -c options: the callee size limit of a call site, and the
+     * size a caller may grow to through inlining.
+     * */
+    const int defaultCalleeSize = 16, defaultCallerSize = 2000;
+
+    /*
+     * Replaces direct calls to small functions by their body, as long as the caller stays
+     * within callerSize instructions. A call site takes callees of up to calleeSize
+     * instructions, twice that inside a loop, and calleeSize / 4 more for every constant
+     * argument. Call sites inside loops get the caller budget first. Every inlined call
+     * site is written to report if it is not NULL.
+     * */
+    void inlineCalls(Program &p, int calleeSize, int callerSize, ostream *report);
+}
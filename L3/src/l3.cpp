@@ -1,54 +1,19 @@
 #include <vector>
 #include <string>
 #include <iostream>
-#include <stack>
-#include <set>
-#include <map>
+#include <algorithm>
 
 #include "l3.h"
+#include "pattern.h"
+#include "liveness.h"
 
 using namespace std;
 
 namespace L3 {
-    int n = 0;
-
-    inline string tsfLabel(const string &label, const map<string, string> &labelMap) {
-        return labelMap.count(label) > 0 ? labelMap.at(label) : label;
-    }
+    bool nativeCalls = false;
 
     vector <string> argReg = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
 
-    TreeNode *mergeTwoTree(TreeNode *up, TreeNode *down) {
-        /*
-         * This is a depth-first-search algorithm.
-         * It will search leaf node of the up side tree, and tries to match the root node
-         * of down side tree. If matched, it will delete the root of down tree, and link
-         * down tree to the up tree, then return.
-         *
-         * It will just match once, even though it is possible to have multiple shared
-         * variables in the same instruction.
-         * */
-        stack<TreeNode *> st;
-        st.push(up);
-        while (!st.empty()) {
-            TreeNode *node = st.top();
-            st.pop();
-            if (node->nextSibling != NULL) {
-                st.push(node->nextSibling);
-            }
-            if (node->firstChild != NULL) {
-                st.push(node->firstChild);
-            } else {
-                if (node->value == down->value) {
-                    node->firstChild = down->firstChild;
-                    delete down;
-                    return up;
-                }
-            }
-        }
-        return NULL;
-    }
-
     ostream &operator<<(ostream &os, Instruction &inst) {
         inst.print(os);
         return os;
@@ -61,12 +26,6 @@ namespace L3 {
         os << var << " <- " << s;
     }
 
-    vector <string> AssignInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        l2.push_back("(" + var + " <- " + tsfLabel(s, labelMap) + ")");
-        return l2;
-    }
-
     TreeNode *AssignInst::getInstTree() {
         TreeNode *varNode = new TreeNode(var), *sNode = new TreeNode(s);
         varNode->firstChild = sNode;
@@ -80,36 +39,6 @@ namespace L3 {
         os << var << " <- " << lt << " " << opToString(op) << " " << rt;
     }
 
-    vector <string> AssignOpInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        string tmp = "_tmp_aop_inst_";
-        if (var == lt) {
-            if (op == ADDQ && rt == "1") {
-                l2.push_back("(" + var + "++)");
-            } else if (op == SUBQ && rt == "1") {
-                l2.push_back("(" + var + "--)");
-            } else {
-                l2.push_back("(" + var + " " + opToString(op) + "= " + rt + ")");
-            }
-        } else if (var == rt && (op == ADDQ || op == IMULQ)) {
-            if (op == ADDQ || op == IMULQ) {
-                if (op == ADDQ && lt == "1") {
-                    l2.push_back("(" + var + "++)");
-                } else {
-                    l2.push_back("(" + var + " " + opToString(op) + "= " + lt + ")");
-                }
-            } else {
-                l2.push_back("(" + tmp + " <- " + lt + ")");
-                l2.push_back("(" + tmp + " " + opToString(op) + "= " + rt + ")");
-                l2.push_back("(" + var + " <- " + tmp + ")");
-            }
-        } else {
-            l2.push_back("(" + var + " <- " + lt + ")");
-            l2.push_back("(" + var + " " + opToString(op) + "= " + rt + ")");
-        }
-        return l2;
-    }
-
     TreeNode *AssignOpInst::getInstTree() {
         TreeNode *varNode = new TreeNode(var), *ltNode = new TreeNode(lt), *rtNode = new TreeNode(rt);
         TreeNode *opNode = new TreeNode(opToString(op));
@@ -126,18 +55,6 @@ namespace L3 {
         os << var << " <- " << lt << " " << cmpToString(cmp) << " " << rt;
     }
 
-    vector <string> AssignCmpInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        if (cmp == LT || cmp == LE || cmp == EQ) {
-            l2.push_back("(" + var + " <- " + lt + " " + cmpToString(cmp) + " " + rt + ")");
-        } else if (cmp == GT) {
-            l2.push_back("(" + var + " <- " + rt + " < " + lt + ")");
-        } else {
-            l2.push_back("(" + var + " <- " + rt + " <= " + lt + ")");
-        }
-        return l2;
-    }
-
     TreeNode *AssignCmpInst::getInstTree() {
         TreeNode *varNode = new TreeNode(var), *ltNode = new TreeNode(lt), *rtNode = new TreeNode(rt);
         TreeNode *cmpNode = new TreeNode(cmpToString(cmp));
@@ -154,12 +71,6 @@ namespace L3 {
         os << lvar << " <- load " << rvar;
     }
 
-    vector <string> LoadInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        l2.push_back("(" + lvar + " <- (mem " + rvar + " 0))");
-        return l2;
-    }
-
     TreeNode *LoadInst::getInstTree() {
         TreeNode *lvarNode = new TreeNode(lvar), *rvarNode = new TreeNode(rvar), *loadNode = new TreeNode("load");
         lvarNode->firstChild = loadNode;
@@ -174,12 +85,6 @@ namespace L3 {
         os << "store " << var << " <- " << s;
     }
 
-    vector <string> StoreInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        l2.push_back("((mem " + var + " 0) <- " + tsfLabel(s, labelMap) + ")");
-        return l2;
-    }
-
     TreeNode *StoreInst::getInstTree() {
         TreeNode *storeNode = new TreeNode("store"), *varNode = new TreeNode(var), *sNode = new TreeNode(s);
         storeNode->firstChild = varNode;
@@ -198,16 +103,6 @@ namespace L3 {
         }
     }
 
-    vector <string> BranchInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        if (var.length() == 0) {
-            l2.push_back("(goto " + tsfLabel(llabel, labelMap) + ")");
-        } else {
-            l2.push_back("(cjump " + var + " = 0 " + tsfLabel(rlabel, labelMap) + " " + tsfLabel(llabel, labelMap) + ")");
-        }
-        return l2;
-    }
-
     TreeNode *BranchInst::getInstTree() {
         TreeNode *brNode = new TreeNode("br"), *llNode = new TreeNode(llabel);
         if (var.length() == 0) {
@@ -228,12 +123,6 @@ namespace L3 {
         os << label;
     }
 
-    vector <string> LabelInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        l2.push_back(tsfLabel(label, labelMap));
-        return l2;
-    }
-
     TreeNode *LabelInst::getInstTree() {
         return new TreeNode(label);
     }
@@ -249,15 +138,6 @@ namespace L3 {
         }
     }
 
-    vector <string> ReturnInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        if (var.length() != 0) {
-            l2.push_back("(rax <- " + var + ")");
-        }
-        l2.push_back("(return)");
-        return l2;
-    }
-
     TreeNode *ReturnInst::getInstTree() {
         TreeNode *retNode = new TreeNode("return");
         if (var.length() != 0) {
@@ -283,29 +163,6 @@ namespace L3 {
         os << ")";
     }
 
-    vector <string> AssignCallInst::toL2(const map<string, string> &labelMap) {
-        vector <string> l2;
-        string calleeRetLabel = (callee[0] == ':' ? callee : ":" + callee) + "_ret" + to_string(++n);
-        for (int i = 0; i < args.size() && i < argReg.size(); i++) {
-            l2.push_back("(" + argReg[i] + " <- " + args[i] + ")");
-        }
-        bool isRunTime = callee == "print" || callee == "allocate" || callee == "array-error";
-        if (!isRunTime) {
-            l2.push_back("((mem rsp -8) <- " + calleeRetLabel + ")");
-            for (int i = 6, sp = -16; i < args.size(); i++, sp -= 8) {
-                l2.push_back("(mem rsp " + to_string(sp) + ") <- " + args[i] + ")");
-            }
-        }
-        l2.push_back("(call " + callee + " " + to_string(args.size()) + ")");
-        if (!isRunTime) {
-            l2.push_back(calleeRetLabel);
-        }
-        if (!var.empty()) {
-            l2.push_back("(" + var + " <- rax)");
-        }
-        return l2;
-    }
-
     TreeNode *AssignCallInst::getInstTree() {
         TreeNode *varNode = new TreeNode(var), *callNode = new TreeNode("call"), *calleeNode = new TreeNode(callee);
         varNode->firstChild = callNode;
@@ -319,44 +176,219 @@ namespace L3 {
     }
 
 
-    Function::~Function() {
-        for (auto const &i : instructions) {
-            delete i;
+    /*
+     * What a tree reads and writes: the variables of its leaves, the variables assigned by
+     * its set nodes, and whether it loads from or writes to memory.
+     * */
+    struct Effects {
+        vector<symbol::Symbol> uses, defs;
+        bool loads = false, writesMemory = false;
+        int size = 0;
+    };
+
+    /*
+     * Folding looks at most foldWindow trees back and only moves trees of up to foldSize
+     * nodes, more than any tile covers. Both keep tree building linear in long blocks.
+     * */
+    const int foldWindow = 32, foldSize = 16;
+
+    bool contains(const vector<symbol::Symbol> &names, const symbol::Symbol &name) {
+        return find(names.begin(), names.end(), name) != names.end();
+    }
+
+    void insertName(vector<symbol::Symbol> &names, const symbol::Symbol &name) {
+        if (!contains(names, name)) {
+            names.push_back(name);
+        }
+    }
+
+    void collectEffects(TreeNode *node, Effects &effects) {
+        effects.size++;
+        if (node->firstChild == NULL) {
+            if (isVarName(node->value) && !isRuntimeFunction(node->value)) {
+                insertName(effects.uses, node->value);
+            }
+            return;
+        }
+        if (isAssign(node)) {
+            insertName(effects.defs, node->value);
+        }
+        effects.loads |= node->value == "load";
+        effects.writesMemory |= node->value == "store" || node->value == "call";
+        for (TreeNode *child = node->firstChild; child != NULL; child = child->nextSibling) {
+            collectEffects(child, effects);
         }
     }
 
-    vector<TreeNode *> Function::getInstTrees() {
-        vector<TreeNode *> trees;
-        TreeNode *mergedTree = NULL;
-        TreeNode *prevTree = instructions[0]->getInstTree();
-        for (int i = 1; i < instructions.size(); i++) {
-            TreeNode *currTree = instructions[i]->getInstTree();
-            mergedTree = mergeTwoTree(currTree, prevTree);
-            if (mergedTree == NULL) {
-                trees.push_back(prevTree);
-                prevTree = currTree;
+    bool intersects(const vector<symbol::Symbol> &a, const vector<symbol::Symbol> &b) {
+        for (auto const &v : a) {
+            if (contains(b, v)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool conflict(const Effects &a, const Effects &b) {
+        return intersects(a.defs, b.uses) || intersects(a.defs, b.defs) || intersects(b.defs, a.uses) ||
+               (a.loads && b.writesMemory) || (b.loads && a.writesMemory);
+    }
+
+    void collectLeaves(TreeNode *node, vector<symbol::Symbol> &leaves) {
+        for (TreeNode *child = node->firstChild; child != NULL; child = child->nextSibling) {
+            if (child->firstChild == NULL) {
+                if (isVarName(child->value) && !isRuntimeFunction(child->value)) {
+                    leaves.push_back(child->value);
+                }
             } else {
-                prevTree = mergedTree;
+                collectLeaves(child, leaves);
             }
         }
-        trees.push_back(mergedTree == NULL ? prevTree : mergedTree);
-        return trees;
     }
 
+    bool replaceLeaf(TreeNode *node, const symbol::Symbol &var, TreeNode *tree) {
+        for (TreeNode **link = &node->firstChild; *link != NULL; link = &(*link)->nextSibling) {
+            if ((*link)->firstChild == NULL && (*link)->value == var) {
+                tree->nextSibling = (*link)->nextSibling;
+                *link = tree;
+                return true;
+            }
+            if (replaceLeaf(*link, var, tree)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-    Program::~Program() {
-        for (auto const &f : functions) {
-            delete f;
+    bool isCommutative(const string &op) {
+        return op == "+" || op == "*" || op == "&" || op == "=";
+    }
+
+    bool sameExpression(TreeNode *a, TreeNode *b) {
+        /*
+         * Whether a and b apply the same operator to the same two leaves.
+         * */
+        TreeNode *al = a->firstChild, *bl = b->firstChild;
+        if (a->value != b->value || al == NULL || bl == NULL || al->nextSibling == NULL || bl->nextSibling == NULL ||
+                al->firstChild != NULL || al->nextSibling->firstChild != NULL ||
+                bl->firstChild != NULL || bl->nextSibling->firstChild != NULL) {
+            return false;
+        }
+        TreeNode *ar = al->nextSibling, *br = bl->nextSibling;
+        return (al->value == bl->value && ar->value == br->value) ||
+               (isCommutative(a->value) && al->value == br->value && ar->value == bl->value);
+    }
+
+    vector<TreeNode *> Function::getInstTrees(Liveness &live) {
+        /*
+         * Trees are built per basic block. The tree of an assignment is folded into the
+         * tree of a later instruction in the block when that is the only use of the
+         * assigned variable and moving the assignment there changes nothing in between:
+         * no variable it reads or writes is touched, and no store or call comes between a
+         * load and its use. A copy of a variable is folded as that variable, calls are never
+         * folded. An operation the block already computed into a variable that still holds
+         * it becomes a copy of that variable, so the shared value stays one temporary.
+         * */
+        vector<TreeNode *> single, trees;
+        vector<Effects> effects;
+        for (auto const &inst : instructions) {
+            single.push_back(inst->getInstTree());
+        }
+        liveAnalysis(single, live);
+        int blockStart = 0;
+        for (int i = 0; i < single.size(); i++) {
+            TreeNode *tree = single[i];
+            if (tree->firstChild == NULL) {
+                blockStart = trees.size();
+            }
+            int windowStart = max(blockStart, (int)trees.size() - foldWindow);
+
+            if (isAssign(tree) && tree->firstChild->firstChild != NULL) {
+                TreeNode *expr = tree->firstChild;
+                Effects operands;
+                collectEffects(expr, operands);
+                for (int k = trees.size() - 1; k >= windowStart && !operands.loads && !operands.writesMemory; k--) {
+                    if (trees[k] == NULL) {
+                        continue;
+                    }
+                    if (isAssign(trees[k]) && !contains(operands.uses, trees[k]->value) &&
+                            sameExpression(trees[k]->firstChild, expr)) {
+                        operands.uses.push_back(trees[k]->value);
+                        bool clobbered = false;
+                        for (int m = k + 1; m < trees.size() && !clobbered; m++) {
+                            clobbered = trees[m] != NULL && intersects(effects[m].defs, operands.uses);
+                        }
+                        if (!clobbered) {
+                            tree->firstChild = new TreeNode(trees[k]->value);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            vector<symbol::Symbol> leaves;
+            collectLeaves(tree, leaves);
+            vector<Effects> folded;
+            for (int l = 0; l < leaves.size(); l++) {
+                const symbol::Symbol &var = leaves[l];
+                if (count(leaves.begin(), leaves.end(), var) != 1 ||
+                        (live.isLiveOut(i, var) && !live.kills(i, var))) {
+                    continue;
+                }
+                int k = trees.size() - 1;
+                while (k >= windowStart && (trees[k] == NULL || !contains(effects[k].defs, var))) {
+                    k--;
+                }
+                if (k < windowStart || !isAssign(trees[k]) || trees[k]->value != var ||
+                        trees[k]->firstChild->value == "call" || effects[k].size > foldSize) {
+                    continue;
+                }
+                bool movable = true;
+                for (int m = k + 1; m < trees.size() && movable; m++) {
+                    movable = trees[m] == NULL || !conflict(effects[k], effects[m]);
+                }
+                for (auto const &other : folded) {
+                    movable = movable && !conflict(effects[k], other);
+                }
+                for (int o = 0; o < leaves.size() && movable; o++) {
+                    movable = o == l || !contains(effects[k].defs, leaves[o]);
+                }
+                if (!movable) {
+                    continue;
+                }
+                TreeNode *def = trees[k], *value = def->firstChild;
+                replaceLeaf(tree, var, value->firstChild == NULL && isVarName(value->value)
+                                       ? new TreeNode(value->value) : def);
+                folded.push_back(effects[k]);
+                trees[k] = NULL;
+            }
+
+            trees.push_back(tree);
+            effects.push_back(Effects());
+            collectEffects(tree, effects.back());
+            if (tree->value == "br" || tree->value == "return") {
+                blockStart = trees.size();
+            }
         }
+        trees.erase(remove(trees.begin(), trees.end(), (TreeNode *)NULL), trees.end());
+        return trees;
     }
 
+
     vector <string> Program::toL2() {
         vector <string> l2;
-        set<string> programLabelSet;
+        /*
+         * Labels of the functions lowered so far and the new names of the labels of the
+         * current function that clash with them, by symbol id. live is refilled for every
+         * function.
+         * */
+        symbol::Set programLabelSet;
+        symbol::Table<symbol::Symbol> labelMap;
+        Liveness live;
         l2.push_back("(" + name);
         for (auto const &f : functions) {
-            set<string> functionLabelSet;
-            map<string, string> labelMap;
+            vector<symbol::Symbol> functionLabels;
+            labelMap.clear();
             l2.push_back("    (" + f->name);
             l2.push_back("        " + to_string(f->arguments.size()) + " 0");
             for (int i = 0; i < f->arguments.size() && i < argReg.size(); i++) {
@@ -368,21 +400,23 @@ namespace L3 {
             for (auto const &inst : f->instructions) {
                 if (LabelInst *lbInst = dynamic_cast<LabelInst *>(inst)) {
                     if (programLabelSet.count(lbInst->label) > 0) {
-                        string newLabel = lbInst->label + "_" + f->name.substr(1) + "_";
+                        symbol::Symbol newLabel = lbInst->label + "_" + f->name.substr(1) + "_";
                         labelMap[lbInst->label] = newLabel;
-                        functionLabelSet.insert(newLabel);
+                        functionLabels.push_back(newLabel);
                     } else {
-                        functionLabelSet.insert(lbInst->label);
+                        functionLabels.push_back(lbInst->label);
                     }
                 }
             }
-            for (auto const &inst : f->instructions) {
-                for (auto const &s : inst->toL2(labelMap)) {
+            for (auto const &tree : f->getInstTrees(live)) {
+                for (auto const &s : getInstFromTree(tree, labelMap)) {
                     l2.push_back("        " + s);
                 }
             }
             l2.push_back("    )");
-            programLabelSet.insert(functionLabelSet.begin(), functionLabelSet.end());
+            for (auto const &label : functionLabels) {
+                programLabelSet.insert(label);
+            }
         }
         l2.push_back(")");
         return l2;
@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <arena.h>
+#include <symbol.h>
 
 #include "tree.h"
 
@@ -11,6 +13,15 @@ using namespace std;
 
 namespace L3 {
 
+    /*
+     * Calls use real call/ret instead of storing a return label and jumping, stack arguments
+     * then start right below the caller's rsp. Set by NATIVE_CALLS=1, which L2 and L1
+     * read as well.
+     * */
+    extern bool nativeCalls;
+
+    extern vector <string> argReg;
+
     enum OP {
         NOP, ADDQ, SUBQ, IMULQ, ANDQ, SALQ, SARQ
     };
@@ -53,145 +64,123 @@ namespace L3 {
                   (cmp == GT ? ">" : "NCMP"))));
     }
 
-    struct Instruction {
+    struct Instruction : arena::Node {
         virtual ~Instruction() {};
 
         virtual void print(ostream &os) = 0;
 
-        virtual vector <string> toL2(const map<string, string> &labelMap) = 0;
-
         virtual TreeNode *getInstTree() = 0;
     };
 
     ostream &operator<<(ostream &os, Instruction &inst);
 
     struct AssignInst : public Instruction {
-        string var, s;
+        symbol::Symbol var, s;
 
         ~AssignInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct AssignOpInst : public Instruction {
-        string var, lt, rt;
+        symbol::Symbol var, lt, rt;
         OP op;
 
         ~AssignOpInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct AssignCmpInst : public Instruction {
-        string var, lt, rt;
+        symbol::Symbol var, lt, rt;
         CMP cmp;
 
         ~AssignCmpInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct LoadInst : public Instruction {
-        string lvar, rvar;
+        symbol::Symbol lvar, rvar;
 
         ~LoadInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct StoreInst : public Instruction {
-        string var, s;
+        symbol::Symbol var, s;
 
         ~StoreInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct BranchInst : public Instruction {
-        string var, llabel, rlabel;
+        symbol::Symbol var, llabel, rlabel;
 
         ~BranchInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct LabelInst : public Instruction {
-        string label;
+        symbol::Symbol label;
 
         ~LabelInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct ReturnInst : public Instruction {
-        string var;
+        symbol::Symbol var;
 
         ~ReturnInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
     struct AssignCallInst : public Instruction {
-        string var, callee;
-        vector <string> args;
+        symbol::Symbol var, callee;
+        vector<symbol::Symbol> args;
 
         ~AssignCallInst();
 
         void print(ostream &os);
 
-        vector <string> toL2(const map<string, string> &labelMap);
-
         TreeNode *getInstTree();
     };
 
-    struct Function {
-        string name;
-        vector <string> arguments;
-        vector<Instruction *> instructions;
+    struct Liveness;
 
-        ~Function();
+    struct Function : arena::Node {
+        symbol::Symbol name;
+        vector<symbol::Symbol> arguments;
+        vector<Instruction *> instructions;
 
-        vector<TreeNode *> getInstTrees();
+        vector<TreeNode *> getInstTrees(Liveness &live);
     };
 
     struct Program {
-        string name;
+        symbol::Symbol name;
         vector<Function *> functions;
 
-        ~Program();
-
         vector <string> toL2();
     };
 
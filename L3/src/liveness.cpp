@@ -0,0 +1,107 @@
+#include <vector>
+#include <string>
+
+#include "liveness.h"
+
+
+using namespace std;
+
+namespace L3 {
+    void collectUses(TreeNode *node, vector<symbol::Symbol> &uses) {
+        if (node->firstChild == NULL) {
+            if (isVarName(node->value) && !isRuntimeFunction(node->value)) {
+                uses.push_back(node->value);
+            }
+            return;
+        }
+        for (TreeNode *child = node->firstChild; child != NULL; child = child->nextSibling) {
+            collectUses(child, uses);
+        }
+    }
+
+    vector<int> successors(const vector<TreeNode *> &trees, const symbol::Table<int> &labels, int i) {
+        TreeNode *tree = trees[i];
+        vector<int> succ;
+        if (tree->value == "return") {
+            return succ;
+        }
+        if (tree->value == "br") {
+            TreeNode *target = tree->firstChild->nextSibling == NULL ? tree->firstChild : tree->firstChild->nextSibling;
+            for (; target != NULL; target = target->nextSibling) {
+                if (labels.count(target->value) > 0) {
+                    succ.push_back(labels.at(target->value));
+                }
+            }
+            return succ;
+        }
+        if (i + 1 < trees.size()) {
+            succ.push_back(i + 1);
+        }
+        return succ;
+    }
+
+    void liveAnalysis(const vector<TreeNode *> &trees, Liveness &live) {
+        int n = trees.size();
+        live.ids.clear();
+        live.labels.clear();
+        live.gen.assign(n, vector<symbol::Symbol>());
+        live.kill.assign(n, vector<symbol::Symbol>());
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            TreeNode *tree = trees[i];
+            if (tree->firstChild == NULL && tree->value[0] == ':') {
+                live.labels[tree->value] = i;
+            } else if (isAssign(tree)) {
+                live.kill[i].push_back(tree->value);
+                collectUses(tree->firstChild, live.gen[i]);
+            } else {
+                collectUses(tree, live.gen[i]);
+            }
+            for (auto const &v : live.gen[i]) {
+                if (live.ids.count(v) == 0) {
+                    live.ids[v] = count++;
+                }
+            }
+            for (auto const &v : live.kill[i]) {
+                if (live.ids.count(v) == 0) {
+                    live.ids[v] = count++;
+                }
+            }
+        }
+        int words = (count + 63) / 64;
+        vector<vector<uint64_t>> gen(n, vector<uint64_t>(words)), keep(n, vector<uint64_t>(words, ~(uint64_t)0));
+        for (int i = 0; i < n; i++) {
+            for (auto const &v : live.gen[i]) {
+                gen[i][live.ids.at(v) / 64] |= (uint64_t)1 << (live.ids.at(v) % 64);
+            }
+            for (auto const &v : live.kill[i]) {
+                keep[i][live.ids.at(v) / 64] &= ~((uint64_t)1 << (live.ids.at(v) % 64));
+            }
+        }
+        vector<vector<int>> succ(n);
+        for (int i = 0; i < n; i++) {
+            succ[i] = successors(trees, live.labels, i);
+        }
+        live.in.assign(n, vector<uint64_t>(words));
+        live.out.assign(n, vector<uint64_t>(words));
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = n - 1; i >= 0; i--) {
+                vector<uint64_t> &out = live.out[i], &in = live.in[i];
+                for (auto s : succ[i]) {
+                    for (int w = 0; w < words; w++) {
+                        out[w] |= live.in[s][w];
+                    }
+                }
+                for (int w = 0; w < words; w++) {
+                    uint64_t bits = gen[i][w] | (out[w] & keep[i][w]);
+                    if (bits != in[w]) {
+                        in[w] = bits;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+
+#include "tree.h"
+
+
+using namespace std;
+
+namespace L3 {
+    /*
+     * Variables used and defined by each instruction of a function, and the variables live
+     * before and after it as bit vectors over ids, computed over the trees of single
+     * instructions. ids numbers the variables and labels holds the instruction of every
+     * label, both by symbol id.
+     * */
+    struct Liveness {
+        symbol::Table<int> ids, labels;
+        vector<vector<symbol::Symbol>> gen, kill;
+        vector<vector<uint64_t>> in, out;
+
+        bool isLiveOut(int i, const symbol::Symbol &var) const {
+            if (ids.count(var) == 0) {
+                return false;
+            }
+            int id = ids.at(var);
+            return (out[i][id / 64] >> (id % 64) & 1) != 0;
+        }
+
+        bool kills(int i, const symbol::Symbol &var) const {
+            return find(kill[i].begin(), kill[i].end(), var) != kill[i].end();
+        }
+    };
+
+    /*
+     * Fills live for trees, reusing its tables from the previous function.
+     * */
+    void liveAnalysis(const vector<TreeNode *> &trees, Liveness &live);
+}
@@ -82,7 +82,7 @@ namespace L3 {
     struct p : seq<plus<seq<seps, f>>, seps> {};
 
     vector<std::string> operators;
-    vector<std::string> operands;
+    vector<symbol::Symbol> operands;
     inline void clearCache() {
         operators.clear();
         operands.clear();
@@ -94,28 +94,28 @@ namespace L3 {
     template<>
     struct action<callee> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<s> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<t> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<u> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
@@ -136,14 +136,14 @@ namespace L3 {
     template<>
     struct action<label> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<var> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
@@ -238,7 +238,7 @@ namespace L3 {
     struct action<labelInst> {
         static void apply(const input &in, Program &p) {
             LabelInst *inst = new LabelInst;
-            inst->label = in.string();
+            inst->label = symbol::Symbol(in.begin(), in.size());
             p.functions.back()->instructions.push_back(inst);
             clearCache();
         }
@@ -1,347 +1,517 @@
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <functional>
 #include <iostream>
+#include <climits>
+#include <algorithm>
 
 #include "tree.h"
+#include "l3.h"
+#include "pattern.h"
 
 
 using namespace std;
 
 namespace L3 {
 
-    vector<string> argRegInTree = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+    int n = 0;
 
-    inline bool isLabel(TreeNode *root) {
-        return root != NULL && root->value[0] == ':';
-    }
-
-    inline bool isReturn(TreeNode *root) {
-        return root != NULL && root->value == "return";
-    }
-
-    inline bool isBranch(TreeNode *root) {
-        return root != NULL && root->value == "br";
-    }
-
-    inline bool isCall(TreeNode *root) {
-        return root != NULL && root->value == "call";
-    }
-
-    inline bool isStore(TreeNode *root) {
-        return root != NULL && root->value == "store";
-    }
-
-    inline bool isLoad(TreeNode *root) {
-        return root != NULL && root->value == "load";
-    }
-
-    inline bool isAddOrSub(TreeNode *root) {
-        return root != NULL && (root->value == "+" || root->value == "-");
-    }
-
-    inline bool isOp(TreeNode *root) {
-        return root != NULL && (root->value == "+" || root->value == "-" ||
-                                root->value == "*" || root->value == "&" ||
-                                root->value == "<<" || root->value == ">>");
-    }
-
-    inline bool isCmp(TreeNode *root) {
-        return root != NULL && (root->value == "<" || root->value == "<=" ||
-                                root->value == "=" || root->value == ">=" || root->value == ">");
-    }
-
-    inline bool isVar(TreeNode *root) {
-        return root != NULL &&
-               ((root->value[0] >= 'A' && root->value[0] <= 'Z') || (root->value[0] >= 'a' && root->value[0] <= 'z')) &&
-               !isLabel(root) && !isReturn(root) && !isBranch(root) && !isCall(root) && !isStore(root) && !isLoad(root);
-    }
-
-    inline bool isNumber(TreeNode *root) {
-        return root != NULL &&
-               (root->value[0] == '+' || root->value[0] == '-' || (root->value[0] >= '0' && root->value[0] <= '9'));
-    }
-
-    inline bool isT(TreeNode *root) {
-        return isNumber(root) || isVar(root);
-    }
-
-    inline bool isS(TreeNode *root) {
-        return isT(root) || isLabel(root);
-    }
-
-    inline bool isU(TreeNode *root) {
-        return isVar(root) || isLabel(root);
-    }
-
-    inline bool isCallee(TreeNode *root) {
-        return root != NULL &&
-               (isU(root) || root->value == "print" || root->value == "allocate" || root->value == "array-error");
-    }
-
-
-    bool movMatch(TreeNode *root) {
-        return isVar(root) && isS(root->firstChild);
-    }
-
-    bool movOpMatch(TreeNode *root) {
-        return isVar(root) && isOp(root->firstChild) &&
-               isT(root->firstChild->firstChild) &&
-               isT(root->firstChild->firstChild->nextSibling);
-    }
-
-    bool movCmpMatch(TreeNode *root) {
-        return isVar(root) && isCmp(root->firstChild) &&
-               isT(root->firstChild->firstChild) &&
-               isT(root->firstChild->firstChild->nextSibling);
-    }
-
-    bool movLoadMatch(TreeNode *root) {
-        return isVar(root) && isLoad(root->firstChild) && isVar(root->firstChild->firstChild);
-    }
-
-    bool storeMatch(TreeNode *root) {
-        return isStore(root) && isVar(root->firstChild) && isS(root->firstChild->nextSibling);
-    }
-
-    bool brLabelMatch(TreeNode *root) {
-        return isBranch(root) && isLabel(root->firstChild);
-    }
-
-    bool labelMatch(TreeNode *root) {
-        return isLabel(root);
+    /*
+     * Binders of the tile patterns, numbered in the order they are first seen.
+     * */
+    int binderIndex(const string &binder) {
+        static vector<string> binders;
+        for (int i = 0; i < binders.size(); i++) {
+            if (binders[i] == binder) {
+                return i;
+            }
+        }
+        binders.push_back(binder);
+        return binders.size() - 1;
     }
 
-    bool brVarLabelMatch(TreeNode *root) {
-        return isBranch(root) && isVar(root->firstChild) &&
-               isLabel(root->firstChild->nextSibling) &&
-               isLabel(root->firstChild->nextSibling->nextSibling);
-    }
+    /*
+     * Names bound by a tile pattern by binder index, an unbound binder holds the empty
+     * name. rest holds the operands matched by a trailing t...
+     * */
+    struct Match {
+        vector<symbol::Symbol> names;
+        vector<symbol::Symbol> rest;
 
-    bool retMatch(TreeNode *root) {
-        return isReturn(root);
-    }
+        bool has(const string &binder) const {
+            int i = binderIndex(binder);
+            return i < names.size() && !names[i].empty();
+        }
 
-    bool retVarMatch(TreeNode *root) {
-        return isReturn(root) && isVar(root->firstChild);
-    }
+        const symbol::Symbol &at(const string &binder) const {
+            static const symbol::Symbol unbound;
+            int i = binderIndex(binder);
+            return i < names.size() ? names[i] : unbound;
+        }
+    };
+
+    /*
+     * A tile covers the tree its pattern matches and derives the nonterminal in front of
+     * it. The pattern is an s-expression over the tree:
+     *
+     *   (set d E)         an assignment to a variable bound to d, whose value is E
+     *   (op E ...)        an operator node, op is an operator, a keyword or one of the
+     *                     classes aop, commutative and lcmp, op:o binds the operator to o
+     *   nt:x              a subtree derived to the nonterminal nt, its name bound to x
+     *   nt...:x           the remaining children, each derived to nt
+     *   1                 the number 1
+     *
+     * A name bound twice must bind the same operand both times. The code lines are emitted
+     * after the code of the subtrees, $x stands for the name bound to x. Ties go to the
+     * tile listed first.
+     * */
+    struct Tile {
+        string nonterminal;
+        string pattern;
+        int cost;
+        vector<string> code;
+        function<bool(const Match &)> when;
+        function<void(const Match &, vector<string> &)> emit;
+
+        Tile(const string &nonterminal, const string &pattern, int cost, const vector<string> &code = {},
+             function<bool(const Match &)> when = nullptr,
+             function<void(const Match &, vector<string> &)> emit = nullptr)
+                : nonterminal(nonterminal), pattern(pattern), cost(cost), code(code), when(when), emit(emit) {
+        }
+    };
 
-    bool callMatch(TreeNode *root) {
-        return isCall(root) && isCallee(root->firstChild);
+    inline function<bool(const Match &)> differ(const string &a, const string &b) {
+        return [a, b](const Match &m) { return m.at(a) != m.at(b); };
     }
 
-    bool movCallMatch(TreeNode *root) {
-        return isVar(root) && callMatch(root->firstChild);
+    inline function<bool(const Match &)> oneOf(const string &a, const vector<string> &values) {
+        return [a, values](const Match &m) {
+            return find(values.begin(), values.end(), m.at(a)) != values.end();
+        };
     }
 
-
-    bool numTimesEight(TreeNode *root) {
-        if (root == NULL) {
-            return false;
-        } else {
-            long num = stoll(root->value);
-            return num % 8 == 0;
+    void emitCall(const Match &m, vector<string> &insts) {
+        const string &callee = m.at("f");
+        const vector<symbol::Symbol> &args = m.rest;
+        string calleeRetLabel = (callee[0] == ':' ? callee : ":" + callee) + "_ret" + to_string(++n);
+        for (int i = 0; i < args.size() && i < argReg.size(); i++) {
+            insts.push_back("(" + argReg[i] + " <- " + args[i] + ")");
         }
-    }
-
-    bool numIsOne(TreeNode *root) {
-        if (root == NULL) {
-            return false;
-        } else {
-            long num = stoll(root->value);
-            return num == 1 || num == -1;
+        bool isRunTime = isRuntimeFunction(callee);
+        if (!isRunTime) {
+            if (!nativeCalls) {
+                insts.push_back("((mem rsp -8) <- " + calleeRetLabel + ")");
+            }
+            for (int i = 6, sp = nativeCalls ? -8 : -16; i < args.size(); i++, sp -= 8) {
+                insts.push_back("((mem rsp " + to_string(sp) + ") <- " + args[i] + ")");
+            }
         }
-    }
-
-    bool ciscNum(TreeNode *root) {
-        if (root == NULL) {
-            return false;
-        } else {
-            long num = stoll(root->value);
-            return num == 0 || num == 2 || num == 4 || num == 8;
+        insts.push_back("(call " + callee + " " + to_string(args.size()) + ")");
+        if (!isRunTime) {
+            insts.push_back(calleeRetLabel);
+        }
+        if (m.has("d")) {
+            insts.push_back("(" + m.at("d") + " <- rax)");
         }
     }
 
-    bool addOrSubForMemMatch(TreeNode *root) {
-        return isVar(root) && isAddOrSub(root->firstChild) &&
-               ((isVar(root->firstChild->firstChild) && numTimesEight(root->firstChild->firstChild->nextSibling))
-                || (numTimesEight(root->firstChild->firstChild) && isVar(root->firstChild->firstChild->nextSibling)));
-    }
-
-    bool movMemMatch(TreeNode *root) {
-        return movLoadMatch(root) && addOrSubForMemMatch(root->firstChild->firstChild);
-    }
+    /*
+     * Address computations that fold into one memory operand (mem b x e disp): b is the
+     * base, x an index scaled by e, m a displacement and c an offset of the index, which
+     * is scaled along with it.
+     * */
+    const vector<string> addresses = {
+            "(set a (+ var:b num:m))",
+            "(set a (+ num:m var:b))",
+            "(set a (+ var:b var:x))",
+            "(set a (+ (set i (* var:x num:e)) var:b))",
+            "(set a (+ var:b (set i (* var:x num:e))))",
+            "(set a (+ (set i (* (set j (+ var:x num:c)) num:e)) var:b))",
+            "(set a (+ (set i (* (set j (+ num:c var:x)) num:e)) var:b))",
+            "(set a (+ var:b (set i (* (set j (+ var:x num:c)) num:e))))",
+            "(set a (+ (set j (+ (set i (* var:x num:e)) num:m)) var:b))",
+            "(set a (+ var:b (set j (+ (set i (* var:x num:e)) num:m))))",
+    };
 
-    bool memMovMatch(TreeNode *root) {
-        return storeMatch(root) && addOrSubForMemMatch(root->firstChild);
+    int64_t scale(const Match &m) {
+        return m.has("e") ? stoll(m.at("e")) : 1;
     }
 
-    bool opMatch(TreeNode *root) {
-        return (movOpMatch(root) || movCmpMatch(root)) && (root->value == root->firstChild->firstChild->value ||
-                                                           root->value ==
-                                                           root->firstChild->firstChild->nextSibling->value);
+    int64_t displacement(const Match &m) {
+        return (m.has("m") ? stoll(m.at("m")) : 0) +
+               (m.has("c") ? stoll(m.at("c")) * scale(m) : 0);
     }
 
-    bool memAddOrSubMatch(TreeNode *root) {
-        return false;
+    bool isAddress(const Match &m) {
+        int64_t e = scale(m), disp = displacement(m);
+        return (e == 1 || e == 2 || e == 4 || e == 8) && disp >= INT_MIN && disp <= INT_MAX;
     }
 
-    bool AddOrSubMemMatch(TreeNode *root) {
-        return (opMatch(root) && isAddOrSub(root->firstChild)) && (addOrSubForMemMatch(root->firstChild->firstChild) ||
-                                                                   addOrSubForMemMatch(
-                                                                           root->firstChild->firstChild->nextSibling));
-    }
+    string memoryOperand(const Match &m) {
+        string disp = to_string(displacement(m));
+        if (!m.has("x")) {
+            return "(mem " + m.at("b") + " " + disp + ")";
+        }
+        return "(mem " + m.at("b") + " " + m.at("x") + " " + to_string(scale(m)) + " " + disp + ")";
+    }
+
+    vector<Tile> makeTiles() {
+        vector<Tile> tiles = {
+            {"var",    "(set d (+ var:d 1))",                                1, {"($d++)"}},
+            {"var",    "(set d (+ 1 var:d))",                                1, {"($d++)"}},
+            {"var",    "(set d (- var:d 1))",                                1, {"($d--)"}},
+            {"var",    "(set d (aop:o var:d t:b))",                          1, {"($d $o= $b)"}},
+            {"var",    "(set d (commutative:o t:a var:d))",                  1, {"($d $o= $a)"}},
+            {"var",    "(set d (aop:o t:a t:b))",                            2, {"($d <- $a)", "($d $o= $b)"}, differ("b", "d")},
+            {"var",    "(set d (aop:o t:a var:d))",                          3, {"(_tmp_aop_inst_ <- $a)", "(_tmp_aop_inst_ $o= $d)", "($d <- _tmp_aop_inst_)"}},
+            {"var",    "(set d (lcmp:c t:a t:b))",                           1, {"($d <- $a $c $b)"}},
+            {"var",    "(set d (> t:a t:b))",                                1, {"($d <- $b < $a)"}},
+            {"var",    "(set d (>= t:a t:b))",                               1, {"($d <- $b <= $a)"}},
+            {"var",    "(set d (load var:a))",                               1, {"($d <- (mem $a 0))"}},
+            {"var",    "(set d (call callee:f t...:args))",                  5, {}, nullptr, emitCall},
+            {"var",    "(set d s:a)",                                        1, {"($d <- $a)"}},
+            {"t",      "var",                                                0},
+            {"t",      "num",                                                0},
+            {"s",      "t",                                                  0},
+            {"s",      "label",                                              0},
+            {"u",      "var",                                                0},
+            {"u",      "label",                                              0},
+            {"callee", "u",                                                  0},
+            {"callee", "func",                                               0},
+            {"stmt",   "var",                                                0},
+            {"stmt",   "label:l",                                            1, {"$l"}},
+            {"stmt",   "(store var:a s:b)",                                  1, {"((mem $a 0) <- $b)"}},
+            {"stmt",   "(br label:l)",                                       1, {"(goto $l)"}},
+            {"stmt",   "(br (set c (lcmp:o t:a t:b)) label:l label:r)",      1, {"(cjump $a $o $b $l $r)"}},
+            {"stmt",   "(br (set c (> t:a t:b)) label:l label:r)",           1, {"(cjump $b < $a $l $r)"}},
+            {"stmt",   "(br (set c (>= t:a t:b)) label:l label:r)",          1, {"(cjump $b <= $a $l $r)"}},
+            {"stmt",   "(br var:c label:l label:r)",                         1, {"(cjump $c = 0 $r $l)"}},
+            {"stmt",   "(return)",                                           1, {"(return)"}},
+            {"stmt",   "(return t:a)",                                       2, {"(rax <- $a)", "(return)"}},
+            {"stmt",   "(call callee:f t...:args)",                          4, {}, nullptr, emitCall},
+            {"var",    "(set d (+ (set i (* var:x num:e)) var:b))",          1, {"($d @ $b $x $e)"}, isAddress},
+            {"var",    "(set d (+ var:b (set i (* var:x num:e))))",          1, {"($d @ $b $x $e)"}, isAddress},
+        };
+        /*
+         * A load used once by +, -, * or & becomes its memory source. A load, update and
+         * store through the same base becomes one read-modify-write of memory.
+         * */
+        auto arith = oneOf("o", {"+", "-", "*", "&"}), rmw = oneOf("o", {"+", "-", "&"});
+        auto emitArith = [](const Match &m, vector<string> &insts) {
+            insts.push_back("(" + m.at("d") + " " + m.at("o") + "= " + memoryOperand(m) + ")");
+        };
+        auto emitUpdate = [](const Match &m, vector<string> &insts) {
+            insts.push_back("(" + memoryOperand(m) + " " + m.at("o") + "= " + m.at("v") + ")");
+        };
+        tiles.push_back({"stmt", "(store var:b (set d (aop:o (set l (load var:b)) t:v)))", 1, {}, rmw, emitUpdate});
+        tiles.push_back({"stmt", "(store var:b (set d (commutative:o t:v (set l (load var:b)))))", 1, {}, rmw, emitUpdate});
+        vector<string> sources = {"var:b"};
+        for (auto const &address : addresses) {
+            if (address.find("var:x") == string::npos) {
+                sources.push_back(address);
+            }
+        }
+        for (auto const &source : sources) {
+            tiles.push_back({"var", "(set d (aop:o var:d (set l (load " + source + "))))", 1, {},
+                             [arith](const Match &m) { return arith(m) && isAddress(m); }, emitArith});
+            tiles.push_back({"var", "(set d (commutative:o (set l (load " + source + ")) var:d))", 1, {},
+                             [arith](const Match &m) { return arith(m) && isAddress(m); }, emitArith});
+        }
+        for (auto const &address : addresses) {
+            tiles.push_back({"var", "(set d (load " + address + "))", 1, {}, isAddress, [](const Match &m, vector<string> &insts) {
+                insts.push_back("(" + m.at("d") + " <- " + memoryOperand(m) + ")");
+            }});
+            tiles.push_back({"stmt", "(store " + address + " s:v)", 1, {}, isAddress, [](const Match &m, vector<string> &insts) {
+                insts.push_back("(" + memoryOperand(m) + " <- " + m.at("v") + ")");
+            }});
+        }
+        return tiles;
+    }
+
+    const vector<Tile> tiles = makeTiles();
+
+    struct Pattern {
+        enum Kind {
+            NONTERMINAL, NUMBER, OPERATOR, SET
+        } kind;
+        string symbol;
+        int binder;
+        int nonterminal;
+        bool variadic;
+        vector<Pattern> children;
+    };
+
+    struct Grammar {
+        vector<string> nonterminals;
+        vector<int> results;
+        vector<Pattern> patterns;
+
+        int nonterminal(const string &name) {
+            for (int i = 0; i < nonterminals.size(); i++) {
+                if (nonterminals[i] == name) {
+                    return i;
+                }
+            }
+            nonterminals.push_back(name);
+            return nonterminals.size() - 1;
+        }
 
-    bool cjumpMatch(TreeNode *root) {
-        return brVarLabelMatch(root) && movCmpMatch(root->firstChild);
-    }
+        Pattern parse(const string &text, int &pos) {
+            Pattern p;
+            p.nonterminal = -1;
+            p.binder = -1;
+            p.variadic = false;
+            while (text[pos] == ' ') {
+                pos++;
+            }
+            if (text[pos] == '(') {
+                pos++;
+                int begin = pos;
+                while (text[pos] != ' ' && text[pos] != ')') {
+                    pos++;
+                }
+                string head = text.substr(begin, pos - begin);
+                size_t colon = head.find(':');
+                p.kind = head == "set" ? Pattern::SET : Pattern::OPERATOR;
+                p.symbol = head.substr(0, colon);
+                p.binder = colon == string::npos ? -1 : binderIndex(head.substr(colon + 1));
+                if (p.kind == Pattern::SET) {
+                    while (text[pos] == ' ') {
+                        pos++;
+                    }
+                    begin = pos;
+                    while (text[pos] != ' ') {
+                        pos++;
+                    }
+                    p.binder = binderIndex(text.substr(begin, pos - begin));
+                }
+                while (true) {
+                    while (text[pos] == ' ') {
+                        pos++;
+                    }
+                    if (text[pos] == ')') {
+                        pos++;
+                        break;
+                    }
+                    p.children.push_back(parse(text, pos));
+                }
+                return p;
+            }
+            int begin = pos;
+            while (pos < text.size() && text[pos] != ' ' && text[pos] != ')') {
+                pos++;
+            }
+            string atom = text.substr(begin, pos - begin);
+            if (atom[0] >= '0' && atom[0] <= '9') {
+                p.kind = Pattern::NUMBER;
+                p.symbol = atom;
+                return p;
+            }
+            size_t colon = atom.find(':');
+            p.kind = Pattern::NONTERMINAL;
+            p.symbol = atom.substr(0, colon);
+            p.binder = colon == string::npos ? -1 : binderIndex(atom.substr(colon + 1));
+            if (p.symbol.size() > 3 && p.symbol.substr(p.symbol.size() - 3) == "...") {
+                p.variadic = true;
+                p.symbol = p.symbol.substr(0, p.symbol.size() - 3);
+            }
+            p.nonterminal = nonterminal(p.symbol);
+            return p;
+        }
 
-    bool gotoMatch(TreeNode *root) {
-        return brLabelMatch(root);
-    }
+        Grammar() {
+            /*
+             * Leaves derive var, num, label and func without a tile.
+             * */
+            for (auto const &leaf : {"var", "num", "label", "func"}) {
+                nonterminal(leaf);
+            }
+            for (auto const &tile : tiles) {
+                int pos = 0;
+                results.push_back(nonterminal(tile.nonterminal));
+                patterns.push_back(parse(tile.pattern, pos));
+            }
+        }
+    };
 
-    bool incOrDecMatch(TreeNode *root) {
-        return opMatch(root) && isAddOrSub(root->firstChild) && (numIsOne(root->firstChild->firstChild) ||
-                                                                 numIsOne(root->firstChild->firstChild->nextSibling));
+    Grammar &grammar() {
+        static Grammar g;
+        return g;
     }
 
-    int getArgNum(TreeNode *root) {
-        int n = 0;
-        TreeNode *cursor = root == NULL || root->firstChild == NULL ? NULL : root->firstChild->nextSibling;
-        while (cursor != NULL) {
-            cursor = cursor->nextSibling;
-            n++;
+    bool operatorMatches(const string &symbol, const string &value) {
+        if (symbol == "aop") {
+            return value == "+" || value == "-" || value == "*" || value == "&" || value == "<<" || value == ">>";
+        } else if (symbol == "commutative") {
+            return value == "+" || value == "*" || value == "&";
+        } else if (symbol == "lcmp") {
+            return value == "<" || value == "<=" || value == "=";
         }
-        return n;
-    }
-
-    bool isRunTimeCall(TreeNode *root) {
-        return callMatch(root) && (root->firstChild->value == "print" || root->firstChild->value == "allocate" ||
-                root->firstChild->value == "array-error");
+        return symbol == value;
     }
 
+    /*
+     * Bottom-up labeling of a tree with the cheapest tile deriving each nonterminal at
+     * each node, followed by the top-down reduction that emits the chosen tiles.
+     * */
+    struct Tiler {
+        const symbol::Table<symbol::Symbol> &labelMap;
+        unordered_map<TreeNode *, vector<pair<int, int>>> covers;
 
-
-
-    void getInstFromTree(vector <string> &insts, TreeNode *root) {
-        if (root == NULL) {
-            return;
+        Tiler(const symbol::Table<symbol::Symbol> &labelMap) : labelMap(labelMap) {
         }
-        if (!labelMatch(root) && !retMatch(root) && root->firstChild == NULL) {
-            return;
+
+        const symbol::Symbol &nameOf(TreeNode *node) {
+            if (node->value[0] == ':' && labelMap.count(node->value) > 0) {
+                return labelMap.at(node->value);
+            }
+            return node->value;
         }
-        if (labelMatch(root)) {
-            insts.push_back(root->value);
-        } else if (retVarMatch(root)) {
-            getInstFromTree(insts, root->firstChild);
-            insts.push_back("(rax <- " + root->value + ")");
-            insts.push_back("(return)");
-        } else if (retMatch(root)) {
-            insts.push_back("(return)");
-        } else if (brLabelMatch(root)) {
-            insts.push_back("(goto " + root->firstChild->value + ")");
-        } else if (brVarLabelMatch(root)) {
-            TreeNode *var = root->firstChild, *llb = var->nextSibling, *rlb = llb->nextSibling;
-            if (cjumpMatch(root)) {
-                TreeNode *cmp = var->firstChild, *l = cmp->firstChild, *r = l->nextSibling;
-                getInstFromTree(insts, l);
-                getInstFromTree(insts, r);
-                insts.push_back("(cjump " + l->value + " " + cmp->value + " " + r->value + " " + llb->value + " " + rlb->value + ")");
-            } else {
-                getInstFromTree(insts, root->firstChild);
-                insts.push_back("(cjump " + var->value + " = 0 " + rlb->value + " " + llb->value + ")");
+
+        bool bind(Match &m, int binder, const symbol::Symbol &name) {
+            if (binder == -1) {
+                return true;
             }
-        } else if (storeMatch(root)) {
-            TreeNode *var = root->firstChild, *s = root->firstChild->nextSibling;
-            if (memMovMatch(root)) {
-                TreeNode *op = var->firstChild, *l = op->firstChild, *r = l->nextSibling;
-                getInstFromTree(insts, l);
-                getInstFromTree(insts, r);
-                insts.push_back("((mem " + l->value + " " + r->value + ") <- " + s->value + ")");
-            } else {
-                getInstFromTree(insts, var);
-                if (!isLabel(s)) {
-                    getInstFromTree(insts, s);
-                }
-                insts.push_back("((mem " + var->value + " 0) <- " + s->value + ")");
+            if (binder >= m.names.size()) {
+                m.names.resize(binder + 1);
             }
-        } else if (callMatch(root)) {
-            int n = getArgNum(root);
-            TreeNode *callee = root->firstChild, *argCursor = callee->nextSibling;
-            for (; argCursor != NULL; argCursor = argCursor->nextSibling) {
-                getInstFromTree(insts, argCursor);
+            if (!m.names[binder].empty()) {
+                return m.names[binder] == name;
             }
-            if (!isRunTimeCall(root)) {
-                insts.push_back("((mem rsp -8) <- " + callee->value + "_ret)");
+            m.names[binder] = name;
+            return true;
+        }
+
+        bool derive(const Pattern &p, TreeNode *node, Match &m, int &cost, vector<pair<TreeNode *, int>> *leaves,
+                    bool rest) {
+            int c = covers[node][p.nonterminal].first;
+            if (c == INT_MAX) {
+                return false;
             }
-            argCursor = callee->nextSibling;
-            for (int i = 0; i < 6 && argCursor != NULL; i++, argCursor = argCursor->nextSibling) {
-                insts.push_back("(" + argRegInTree[i] + " <- " + argCursor->value + ")");
+            cost += c;
+            if (leaves != NULL) {
+                leaves->push_back(make_pair(node, p.nonterminal));
             }
-            if (!isRunTimeCall(root)) {
-                for (int sp = -16; argCursor != NULL; sp -= 8, argCursor = argCursor->nextSibling) {
-                    insts.push_back("((mem rsp " + to_string(sp) + ") <- " + argCursor->value + ")");
-                }
+            if (rest) {
+                m.rest.push_back(nameOf(node));
+                return true;
+            }
+            return bind(m, p.binder, nameOf(node));
+        }
+
+        bool matches(const Pattern &p, TreeNode *node, Match &m, int &cost, vector<pair<TreeNode *, int>> *leaves) {
+            switch (p.kind) {
+                case Pattern::NONTERMINAL:
+                    return derive(p, node, m, cost, leaves, false);
+                case Pattern::NUMBER:
+                    return node->firstChild == NULL && isNumberName(node->value) && stoll(node->value) == stoll(p.symbol);
+                case Pattern::SET:
+                    return isAssign(node) && bind(m, p.binder, node->value) &&
+                           matches(p.children[0], node->firstChild, m, cost, leaves);
+                case Pattern::OPERATOR:
+                    if (!operatorMatches(p.symbol, node->value) || !bind(m, p.binder, node->value)) {
+                        return false;
+                    }
+                    TreeNode *child = node->firstChild;
+                    for (auto const &c : p.children) {
+                        if (c.variadic) {
+                            for (; child != NULL; child = child->nextSibling) {
+                                if (!derive(c, child, m, cost, leaves, true)) {
+                                    return false;
+                                }
+                            }
+                            break;
+                        }
+                        if (child == NULL || !matches(c, child, m, cost, leaves)) {
+                            return false;
+                        }
+                        child = child->nextSibling;
+                    }
+                    return child == NULL;
             }
-            insts.push_back("(call " + callee->value + " " + to_string(n) + ")");
-            if (!isRunTimeCall(root)) {
-                insts.push_back(callee->value + "_ret");
+            return false;
+        }
+
+        void label(TreeNode *node) {
+            for (TreeNode *child = node->firstChild; child != NULL; child = child->nextSibling) {
+                label(child);
             }
-        } else if (movCallMatch(root)) {
-            getInstFromTree(insts, root->firstChild);
-            insts.push_back("(" + root->value + " <- rax)");
-        } else if (movLoadMatch(root)) {
-            TreeNode *var = root->firstChild->firstChild;
-            if (movMemMatch(root)) {
-                TreeNode *op = var->firstChild, *l = op->firstChild, *r = l->nextSibling;
-                getInstFromTree(insts, l);
-                getInstFromTree(insts, r);
-                if (isNumber(l)) {
-                    insts.push_back("(" + root->value + " <- (mem " + r->value + " " + l->value + "))");
-                } else {
-                    insts.push_back("(" + root->value + " <- (mem " + l->value + " " + r->value + "))");
+            Grammar &g = grammar();
+            vector<pair<int, int>> &cover = covers[node];
+            cover.assign(g.nonterminals.size(), make_pair(INT_MAX, -1));
+            if (node->firstChild == NULL) {
+                const string &v = node->value;
+                if (isNumberName(v)) {
+                    cover[g.nonterminal("num")].first = 0;
+                } else if (v[0] == ':') {
+                    cover[g.nonterminal("label")].first = 0;
+                } else if (isRuntimeFunction(v)) {
+                    cover[g.nonterminal("func")].first = 0;
+                } else if (isVarName(v)) {
+                    cover[g.nonterminal("var")].first = 0;
                 }
-            } else {
-                getInstFromTree(insts, var);
-                insts.push_back("(" + root->value + " <- (mem " + var->value + " 0))");
             }
-        } else if (movOpMatch(root)) {
-            TreeNode *op = root->firstChild, *l = op->firstChild, *r = l->nextSibling;
-            if (incOrDecMatch(root)) {
-                if (root->firstChild->value == "+") {
-                    insts.push_back("(" + root->value + "++)");
-                } else {
-                    insts.push_back("(" + root->value + "--)");
-                }
-            } else if (opMatch(root)) {
-                if (l->value == root->value) {
-                    getInstFromTree(insts, r);
-                    insts.push_back("(" + root->value + " " + op->value + "= " + r->value + ")");
-                } else {
-                    getInstFromTree(insts, l);
-                    insts.push_back("(" + root->value + " " + op->value + "= " + l->value + ")");
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (int i = 0; i < tiles.size(); i++) {
+                    Match m;
+                    int cost = tiles[i].cost;
+                    if (matches(g.patterns[i], node, m, cost, NULL) && (!tiles[i].when || tiles[i].when(m)) &&
+                            cost < covers[node][g.results[i]].first) {
+                        covers[node][g.results[i]] = make_pair(cost, i);
+                        changed = true;
+                    }
                 }
-            } else {
-                getInstFromTree(insts, l);
-                getInstFromTree(insts, r);
-                insts.push_back("(" + root->value + " <- " + l->value + ")");
-                insts.push_back("(" + root->value + " " + op->value + "= " + r->value + ")");
             }
-        } else if (movCmpMatch(root)) {
-            TreeNode *cmp = root->firstChild, *l = cmp->firstChild, *r = l->nextSibling;
-            getInstFromTree(insts, l);
-            getInstFromTree(insts, r);
-            insts.push_back("(" + root->value + " <- " + l->value + " " + cmp->value + " " + r->value + ")");
-        } else if (movMatch(root)) {
-            getInstFromTree(insts, root->firstChild);
-            insts.push_back("(" + root->value + " <- " + root->firstChild->value + ")");
-        } else {
-            cerr << "error matching" << endl;
         }
-    }
 
-    vector <string> getInstFromTree(TreeNode *tree) {
-        vector <string> insts;
-        getInstFromTree(insts, tree);
+        void reduce(TreeNode *node, int nonterminal, vector<string> &insts) {
+            int i = covers[node][nonterminal].second;
+            if (i == -1) {
+                return;
+            }
+            Match m;
+            int cost = 0;
+            vector<pair<TreeNode *, int>> leaves;
+            matches(grammar().patterns[i], node, m, cost, &leaves);
+            for (auto const &leaf : leaves) {
+                reduce(leaf.first, leaf.second, insts);
+            }
+            if (tiles[i].emit) {
+                tiles[i].emit(m, insts);
+                return;
+            }
+            for (auto const &line : tiles[i].code) {
+                string inst;
+                for (int k = 0; k < line.size(); k++) {
+                    if (line[k] != '$') {
+                        inst += line[k];
+                        continue;
+                    }
+                    int begin = ++k;
+                    while (k < line.size() && ((line[k] >= 'a' && line[k] <= 'z') || (line[k] >= 'A' && line[k] <= 'Z'))) {
+                        k++;
+                    }
+                    inst += m.at(line.substr(begin, k - begin)).str();
+                    k--;
+                }
+                insts.push_back(inst);
+            }
+        }
+    };
+
+    vector<string> getInstFromTree(TreeNode *tree, const symbol::Table<symbol::Symbol> &labelMap) {
+        vector<string> insts;
+        Tiler tiler(labelMap);
+        tiler.label(tree);
+        int stmt = grammar().nonterminal("stmt");
+        if (tiler.covers[tree][stmt].first == INT_MAX) {
+            cerr << "error matching " << tree->value << endl;
+            return insts;
+        }
+        tiler.reduce(tree, stmt, insts);
         return insts;
     }
-}
\ No newline at end of file
+}
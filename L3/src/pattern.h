@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <map>
 
 #include "tree.h"
 
@@ -9,5 +10,5 @@
 using namespace std;
 
 namespace L3 {
-    vector<string> getInstFromTree(TreeNode *tree);
-}
\ No newline at end of file
+    vector<string> getInstFromTree(TreeNode *tree, const symbol::Table<symbol::Symbol> &labelMap);
+}
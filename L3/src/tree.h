@@ -2,21 +2,45 @@
 
 #include <vector>
 #include <string>
+#include <arena.h>
+#include <symbol.h>
 
 using namespace std;
 
 
 struct TreeNode;
 
-struct TreeNode {
-    string value;
+struct TreeNode : arena::Node {
+    symbol::Symbol value;
     TreeNode *firstChild;
     TreeNode *nextSibling;
 
-    TreeNode(const string &v) {
+    TreeNode(const symbol::Symbol &v) {
         value = v;
         firstChild = NULL;
         nextSibling = NULL;
     }
 };
 
+namespace L3 {
+    inline bool isNumberName(const string &s) {
+        return s[0] == '+' || s[0] == '-' || (s[0] >= '0' && s[0] <= '9');
+    }
+
+    inline bool isKeyword(const string &s) {
+        return s == "return" || s == "br" || s == "call" || s == "store" || s == "load";
+    }
+
+    inline bool isVarName(const string &s) {
+        return ((s[0] >= 'A' && s[0] <= 'Z') || (s[0] >= 'a' && s[0] <= 'z') || s[0] == '_') && !isKeyword(s);
+    }
+
+    inline bool isRuntimeFunction(const string &name) {
+        return name == "print" || name == "allocate" || name == "array-error";
+    }
+
+    inline bool isAssign(TreeNode *node) {
+        return node->firstChild != NULL && node->firstChild->nextSibling == NULL && isVarName(node->value);
+    }
+}
+
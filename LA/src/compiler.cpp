@@ -36,5 +36,6 @@ int main(int argc, char **argv) {
     Program p = ParseFile(argv[optind]);
     output << p.toIR() << endl;
     output.close();
+    arena::report("LA");
     return 0;
 }
\ No newline at end of file
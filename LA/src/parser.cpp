@@ -95,7 +95,7 @@ namespace LA {
     struct p : seq<plus<seq<wSeps, f>>, wSeps> {};
 
 
-    vector<std::string> operands;
+    vector<symbol::Symbol> operands;
 
     template<typename Rule>
     struct action : nothing<Rule> {};
@@ -103,63 +103,63 @@ namespace LA {
     template<>
     struct action<T> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<type> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<callee> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<s> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<t> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<op> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<name> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<label> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<var> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
@@ -188,7 +188,7 @@ namespace LA {
     template<>
     struct action<labelInst> {
         static void apply(const input &in, Program &p) {
-            p.functions.back()->instructions.push_back(new LabelInst(in.string()));
+            p.functions.back()->instructions.push_back(new LabelInst(symbol::Symbol(in.begin(), in.size())));
             operands.clear();
         }
     };
@@ -258,7 +258,7 @@ namespace LA {
     struct action<arrayToVarInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 7);
-            std::string lv = operands[4], rv = operands[5];
+            symbol::Symbol lv = operands[4], rv = operands[5];
             operands.erase(operands.begin(), operands.begin() + 6);
             p.functions.back()->instructions.push_back(new AssignInst(lv, rv, operands));
             operands.clear();
@@ -269,7 +269,7 @@ namespace LA {
     struct action<varToArrayInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 8);
-            std::string var = operands[5], s = operands.back();
+            symbol::Symbol var = operands[5], s = operands.back();
             operands.erase(operands.begin(), operands.begin() + 6);
             operands.pop_back();
             p.functions.back()->instructions.push_back(new AssignInst(var, operands, s));
@@ -290,7 +290,7 @@ namespace LA {
     struct action<callInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 1);
-            std::string callee = operands[0];
+            symbol::Symbol callee = operands[0];
             operands.erase(operands.begin());
             p.functions.back()->instructions.push_back(new AssignCallInst(callee, operands));
             operands.clear();
@@ -301,7 +301,7 @@ namespace LA {
     struct action<assignCallInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 4);
-            std::string var = operands[2], callee = operands[3];
+            symbol::Symbol var = operands[2], callee = operands[3];
             operands.erase(operands.begin(), operands.begin() + 4);
             p.functions.back()->instructions.push_back(new AssignCallInst(var, callee, operands));
             operands.clear();
@@ -312,7 +312,7 @@ namespace LA {
     struct action<newArrayInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 3);
-            std::string var = operands[1];
+            symbol::Symbol var = operands[1];
             operands.erase(operands.begin(), operands.begin() + 2);
             p.functions.back()->instructions.push_back(new NewArrayInst(var, operands));
             operands.clear();
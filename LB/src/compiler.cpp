@@ -38,5 +38,6 @@ int main(int argc, char **argv) {
     LA::Program pla = p.getLA();
     output << pla << endl;
     output.close();
+    arena::report("LB");
     return 0;
 }
\ No newline at end of file
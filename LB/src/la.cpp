@@ -3,6 +3,7 @@
 #include <set>
 #include <cassert>
 #include <map>
+#include <algorithm>
 
 #include "la.h"
 
@@ -67,7 +68,7 @@ namespace LA {
         return os;
     }
 
-    LabelInst::LabelInst(const string &s) {
+    LabelInst::LabelInst(const symbol::Symbol &s) {
         lb = s;
     }
 
@@ -75,15 +76,15 @@ namespace LA {
         os << lb;
     }
 
-    vector <string> LabelInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> LabelInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         return {lb};
     }
 
-    BranchInst::BranchInst(const string &s) {
+    BranchInst::BranchInst(const symbol::Symbol &s) {
         lb = s;
     }
 
-    BranchInst::BranchInst(const string &t, const string &lb, const string &rb) {
+    BranchInst::BranchInst(const symbol::Symbol &t, const symbol::Symbol &lb, const symbol::Symbol &rb) {
         this->t = t;
         this->lb = lb;
         this->rb = rb;
@@ -97,7 +98,7 @@ namespace LA {
         }
     }
 
-    vector <string> BranchInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> BranchInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         vector <string> ir;
         if (t.empty()) {
             ir.push_back("br " + lb);
@@ -110,7 +111,7 @@ namespace LA {
         return ir;
     }
 
-    ReturnInst::ReturnInst(const string &s) {
+    ReturnInst::ReturnInst(const symbol::Symbol &s) {
         t = s;
     }
 
@@ -121,11 +122,11 @@ namespace LA {
         }
     }
 
-    vector <string> ReturnInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> ReturnInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         return {t.empty() ? "return" : "return " + t};
     }
 
-    TypeInst::TypeInst(const string &t, const string &v) {
+    TypeInst::TypeInst(const symbol::Symbol &t, const symbol::Symbol &v) {
         type = Type(t);
         var = v;
     }
@@ -134,7 +135,7 @@ namespace LA {
         os << type.toString() << " " << var;
     }
 
-    vector <string> TypeInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> TypeInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         varMap[var] = type;
         vector <string> ir = {type.toString() + " " + var};
         if (type.type == TUPLE || type.dim > 0) {
@@ -143,18 +144,18 @@ namespace LA {
         return ir;
     }
 
-    AssignInst::AssignInst(const string &v, const string &s) {
+    AssignInst::AssignInst(const symbol::Symbol &v, const symbol::Symbol &s) {
         var = v;
         this->s = s;
     }
 
-    AssignInst::AssignInst(const string &v, const vector <string> &ts, const string &s) {
+    AssignInst::AssignInst(const symbol::Symbol &v, const vector<symbol::Symbol> &ts, const symbol::Symbol &s) {
         var = v;
         this->s = s;
         varIndex = ts;
     }
 
-    AssignInst::AssignInst(const string &lv, const string &rv, const vector <string> &ts) {
+    AssignInst::AssignInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const vector<symbol::Symbol> &ts) {
         var = lv;
         s = rv;
         sIndex = ts;
@@ -177,10 +178,10 @@ namespace LA {
         }
     }
 
-    vector <string> AssignInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> AssignInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         vector <string> ir;
-        vector <string> indices;
-        string v;
+        vector<symbol::Symbol> indices;
+        symbol::Symbol v;
         if (!varIndex.empty()) {
             indices = varIndex;
             v = var;
@@ -245,7 +246,7 @@ namespace LA {
         return ir;
     }
 
-    AssignOpInst::AssignOpInst(const string &var, const string &lt, const string &rt, const string &op) {
+    AssignOpInst::AssignOpInst(const symbol::Symbol &var, const symbol::Symbol &lt, const symbol::Symbol &rt, const symbol::Symbol &op) {
         this->var = var;
         this->lt = lt;
         this->rt = rt;
@@ -256,7 +257,7 @@ namespace LA {
         os << var << " <- " << lt << " " << opToString(op) << " " << rt;
     }
 
-    vector <string> AssignOpInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> AssignOpInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         vector <string> ir;
         string nlt = lt, nrt = rt;
         if (!isNum(lt)) {
@@ -275,7 +276,7 @@ namespace LA {
         return ir;
     }
 
-    AssignLengthInst::AssignLengthInst(const string &lv, const string &rv, const string &t) {
+    AssignLengthInst::AssignLengthInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const symbol::Symbol &t) {
         this->lv = lv;
         this->rv = rv;
         this->t = t;
@@ -285,7 +286,7 @@ namespace LA {
         os << lv << " <- length " << rv << " " << t;
     }
 
-    vector <string> AssignLengthInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> AssignLengthInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         vector <string> ir;
         string nt = t;
         if (!isNum(t)) {
@@ -297,12 +298,12 @@ namespace LA {
         return ir;
     }
 
-    AssignCallInst::AssignCallInst(const string &c, const vector <string> &as) {
+    AssignCallInst::AssignCallInst(const symbol::Symbol &c, const vector<symbol::Symbol> &as) {
         callee = c;
         args = as;
     }
 
-    AssignCallInst::AssignCallInst(const string &v, const string &c, const vector <string> &as) {
+    AssignCallInst::AssignCallInst(const symbol::Symbol &v, const symbol::Symbol &c, const vector<symbol::Symbol> &as) {
         var = v;
         callee = c;
         args = as;
@@ -322,12 +323,12 @@ namespace LA {
         os << ")";
     }
 
-    vector <string> AssignCallInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> AssignCallInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         stringstream ss;
         if (!var.empty()) {
             ss << var << " <- ";
         }
-        ss << "call " << (isVar(callee) || isRunTime(callee) ? callee : ":" + callee) << "(";
+        ss << "call " << (isVar(callee) || isRunTime(callee) ? callee.str() : ":" + callee) << "(";
         for (int i = 0; i < args.size(); i++) {
             if (i > 0) {
                 ss << ", ";
@@ -338,7 +339,7 @@ namespace LA {
         return {ss.str()};
     }
 
-    NewArrayInst::NewArrayInst(const string &v, const vector <string> as) {
+    NewArrayInst::NewArrayInst(const symbol::Symbol &v, const vector<symbol::Symbol> &as) {
         var = v;
         args = as;
     }
@@ -354,7 +355,7 @@ namespace LA {
         os << ")";
     }
 
-    vector <string> NewArrayInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> NewArrayInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         stringstream ss;
         ss << var << " <- new Array(";
         for (int i = 0; i < args.size(); i++) {
@@ -367,7 +368,7 @@ namespace LA {
         return {ss.str()};
     }
 
-    NewTupleInst::NewTupleInst(const string &v, const string &t) {
+    NewTupleInst::NewTupleInst(const symbol::Symbol &v, const symbol::Symbol &t) {
         var = v;
         this->t = t;
     }
@@ -376,22 +377,13 @@ namespace LA {
         os << var << " <- new Tuple(" << t << ")";
     }
 
-    vector <string> NewTupleInst::toIR(set <string> &nVarSet, map<string, Type> &varMap) {
+    vector <string> NewTupleInst::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
         return {var + " <- new Tuple(" + encodeIfNum(t) + ")"};
     }
 
-    Function::~Function() {
-        for (auto const &arg : arguments) {
-            delete arg;
-        }
-        for (auto const &inst : instructions) {
-            delete inst;
-        }
-    }
-
-    string Function::toIR() {
-        map<string, Type> varMap;
-        set<string> nVarSet;
+    string Function::toIR(symbol::Set &nVarSet, symbol::Table<Type> &varMap) {
+        nVarSet.clear();
+        varMap.clear();
         stringstream ss;
         ss << "define " << returnType.toString() << " :" << name << "(";
         for (int i = 0; i < arguments.size(); i++) {
@@ -419,7 +411,9 @@ namespace LA {
                 startBasicBlock = true;
             }
         }
-        for (auto const &nVar : nVarSet) {
+        vector<symbol::Symbol> nVars = nVarSet.keys();
+        sort(nVars.begin(), nVars.end());
+        for (auto const &nVar : nVars) {
             irs.insert(irs.begin() + 1, "int64 " + nVar);
         }
         for (auto const &s : irs) {
@@ -445,16 +439,16 @@ namespace LA {
         return os;
     }
 
-    Program::~Program() {
-        for (auto const &f : functions) {
-            delete f;
-        }
-    }
-
     string Program::toIR() {
+        /*
+         * Variables the lowering adds and the types of all variables of the function being
+         * lowered, by symbol id.
+         * */
+        symbol::Set nVarSet;
+        symbol::Table<Type> varMap;
         stringstream ss;
         for (auto const &f : functions) {
-            ss << f->toIR() << endl;
+            ss << f->toIR(nVarSet, varMap) << endl;
         }
         return ss.str();
     }
@@ -30,35 +30,35 @@ namespace LB {
         return ":NewLabel" + to_string(idx++);
     }
 
-    string getNewVar(Scope* scope, const string &v, map<Scope *, map<string, string>> &varMap) {
+    symbol::Symbol getNewVar(const symbol::Symbol &v, VarMap &varMap) {
         if (!isVar(v)) {
             return v;
         }
-        while (scope != NULL && varMap.at(scope).count(v) <= 0) {
-            scope = scope->parent;
-        }
-        if (varMap.at(scope).count(v) <= 0) {
+        if (varMap.count(v) <= 0 || varMap.at(v).empty()) {
             throw runtime_error("undefined variable: " + v);
         }
-        return varMap.at(scope).at(v);
+        return varMap.at(v).back();
     }
 
-    void removeScope(Scope *scope, const string &id, map<Scope *, map<string, string>> &varMap, vector<Instruction *> &insts) {
-        map<string, string> m;
-        varMap[scope] = m;
+    void removeScope(Scope *scope, const string &id, VarMap &varMap, vector<Instruction *> &insts) {
+        vector<symbol::Symbol> declared;
         int index = 0, idx = 0;
         for (auto const &inst : scope->instructions) {
             if (Scope *s = dynamic_cast<Scope *>(inst)) {
                 removeScope(s, id + "d" + to_string(index++), varMap, insts);
             } else if (TypeInst *t = dynamic_cast<TypeInst *>(inst)) {
                 for (auto const &v : t->vars) {
-                    varMap[scope][v] = "%Var" + id + "I" + to_string(idx++);
+                    varMap[v].push_back("%Var" + id + "I" + to_string(idx++));
+                    declared.push_back(v);
                 }
-                insts.push_back(t->getInstWithNewVar(scope, varMap));
+                insts.push_back(t->getInstWithNewVar(varMap));
             } else {
-                insts.push_back(inst->getInstWithNewVar(scope, varMap));
+                insts.push_back(inst->getInstWithNewVar(varMap));
             }
         }
+        for (auto const &v : declared) {
+            varMap[v].pop_back();
+        }
     }
 
     Type::Type(const string &s) {
@@ -83,7 +83,7 @@ namespace LB {
         return os;
     }
 
-    TypeInst::TypeInst(const string &t, const vector<string> &vars) {
+    TypeInst::TypeInst(const symbol::Symbol &t, const vector<symbol::Symbol> &vars) {
         type = Type(t);
         this->vars = vars;
     }
@@ -101,10 +101,10 @@ namespace LB {
         }
     }
 
-    Instruction *TypeInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        vector<string> nVars;
+    Instruction *TypeInst::getInstWithNewVar(VarMap &varMap) {
+        vector<symbol::Symbol> nVars;
         for (auto const &v : vars) {
-            nVars.push_back(getNewVar(scope, v, varMap));
+            nVars.push_back(getNewVar(v, varMap));
         }
         return new TypeInst(type.toString(), nVars);
     }
@@ -118,18 +118,18 @@ namespace LB {
         return la;
     }
 
-    AssignInst::AssignInst(const string &v, const string &s) {
+    AssignInst::AssignInst(const symbol::Symbol &v, const symbol::Symbol &s) {
         var = v;
         this->s = s;
     }
 
-    AssignInst::AssignInst(const string &v, const vector <string> &ts, const string &s) {
+    AssignInst::AssignInst(const symbol::Symbol &v, const vector<symbol::Symbol> &ts, const symbol::Symbol &s) {
         var = v;
         this->s = s;
         varIndex = ts;
     }
 
-    AssignInst::AssignInst(const string &lv, const string &rv, const vector <string> &ts) {
+    AssignInst::AssignInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const vector<symbol::Symbol> &ts) {
         var = lv;
         s = rv;
         sIndex = ts;
@@ -152,18 +152,18 @@ namespace LB {
         }
     }
 
-    Instruction *AssignInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        string nv = getNewVar(scope, var, varMap), ns = getNewVar(scope, s, varMap);
+    Instruction *AssignInst::getInstWithNewVar(VarMap &varMap) {
+        symbol::Symbol nv = getNewVar(var, varMap), ns = getNewVar(s, varMap);
         if (!varIndex.empty()) {
-            vector<string> nvIndex;
+            vector<symbol::Symbol> nvIndex;
             for (auto const &v : varIndex) {
-                nvIndex.push_back(getNewVar(scope, v, varMap));
+                nvIndex.push_back(getNewVar(v, varMap));
             }
             return new AssignInst(nv, nvIndex, ns);
         } else if (!sIndex.empty()) {
-            vector<string> nsIndex;
+            vector<symbol::Symbol> nsIndex;
             for (auto const &v : sIndex) {
-                nsIndex.push_back(getNewVar(scope, v, varMap));
+                nsIndex.push_back(getNewVar(v, varMap));
             }
             return new AssignInst(nv, ns, nsIndex);
         } else {
@@ -181,7 +181,7 @@ namespace LB {
         }
     }
 
-    AssignCondInst::AssignCondInst(const string &var, const string &lt, const string &op, const string &rt) {
+    AssignCondInst::AssignCondInst(const symbol::Symbol &var, const symbol::Symbol &lt, const symbol::Symbol &op, const symbol::Symbol &rt) {
         this->var = var;
         this->lt = lt;
         this->rt = rt;
@@ -192,16 +192,16 @@ namespace LB {
         os << var << " <- " << lt << " " << opToString(op) << " " << rt;
     }
 
-    Instruction *AssignCondInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        return new AssignCondInst(getNewVar(scope, var, varMap), getNewVar(scope, lt, varMap), opToString(op),
-            getNewVar(scope, rt, varMap));
+    Instruction *AssignCondInst::getInstWithNewVar(VarMap &varMap) {
+        return new AssignCondInst(getNewVar(var, varMap), getNewVar(lt, varMap), opToString(op),
+            getNewVar(rt, varMap));
     }
 
     vector<LA::Instruction *> AssignCondInst::getLA() {
         return {new LA::AssignOpInst(var, lt, rt, opToString(op))};
     }
 
-    LabelInst::LabelInst(const string &s) {
+    LabelInst::LabelInst(const symbol::Symbol &s) {
         lb = s;
     }
 
@@ -209,7 +209,7 @@ namespace LB {
         os << lb;
     }
 
-    Instruction *LabelInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
+    Instruction *LabelInst::getInstWithNewVar(VarMap &varMap) {
         return new LabelInst(lb);
     }
 
@@ -217,7 +217,7 @@ namespace LB {
         return {new LA::LabelInst(lb)};
     }
 
-    IfInst::IfInst(const string &lt, const string &op, const string &rt, const string &lb, const string &rb) {
+    IfInst::IfInst(const symbol::Symbol &lt, const symbol::Symbol &op, const symbol::Symbol &rt, const symbol::Symbol &lb, const symbol::Symbol &rb) {
         this->lt = lt;
         this->rt = rt;
         this->lb = lb;
@@ -229,15 +229,15 @@ namespace LB {
         os << "if (" << lt << " " << opToString(op) << " " << rt << ") " << lb << " " << rb;
     }
 
-    Instruction *IfInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        return new IfInst(getNewVar(scope, lt, varMap), opToString(op), getNewVar(scope, rt, varMap), lb, rb);
+    Instruction *IfInst::getInstWithNewVar(VarMap &varMap) {
+        return new IfInst(getNewVar(lt, varMap), opToString(op), getNewVar(rt, varMap), lb, rb);
     }
 
     vector<LA::Instruction *> IfInst::getLA() {
         throw runtime_error("IfInst::getLA() not implemented");
     }
 
-    ReturnInst::ReturnInst(const string &s) {
+    ReturnInst::ReturnInst(const symbol::Symbol &s) {
         t = s;
     }
 
@@ -248,15 +248,15 @@ namespace LB {
         }
     }
 
-    Instruction *ReturnInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        return new ReturnInst(getNewVar(scope, t, varMap));
+    Instruction *ReturnInst::getInstWithNewVar(VarMap &varMap) {
+        return new ReturnInst(getNewVar(t, varMap));
     }
 
     vector<LA::Instruction *> ReturnInst::getLA() {
         return {new LA::ReturnInst(t)};
     }
 
-    WhileInst::WhileInst(const string &lt, const string &op, const string &rt, const string &lb, const string &rb) {
+    WhileInst::WhileInst(const symbol::Symbol &lt, const symbol::Symbol &op, const symbol::Symbol &rt, const symbol::Symbol &lb, const symbol::Symbol &rb) {
         this->lt = lt;
         this->rt = rt;
         this->lb = lb;
@@ -268,8 +268,8 @@ namespace LB {
         os << "while (" << lt << " " << opToString(op) << " " << rt << ") " << lb << " " << rb;
     }
 
-    Instruction *WhileInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        return new WhileInst(getNewVar(scope, lt, varMap), opToString(op), getNewVar(scope, rt, varMap), lb, rb);
+    Instruction *WhileInst::getInstWithNewVar(VarMap &varMap) {
+        return new WhileInst(getNewVar(lt, varMap), opToString(op), getNewVar(rt, varMap), lb, rb);
     }
 
     vector<LA::Instruction *> WhileInst::getLA() {
@@ -280,7 +280,7 @@ namespace LB {
         os << "continue";
     }
 
-    Instruction *ContinueInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
+    Instruction *ContinueInst::getInstWithNewVar(VarMap &varMap) {
         return new ContinueInst();
     }
 
@@ -292,7 +292,7 @@ namespace LB {
         os << "break";
     }
 
-    Instruction *BreakInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
+    Instruction *BreakInst::getInstWithNewVar(VarMap &varMap) {
         return new BreakInst();
     }
 
@@ -300,7 +300,7 @@ namespace LB {
         throw runtime_error("BreakInst::getLA() not implemented");
     }
 
-    AssignLengthInst::AssignLengthInst(const string &lv, const string &rv, const string &t) {
+    AssignLengthInst::AssignLengthInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const symbol::Symbol &t) {
         this->lv = lv;
         this->rv = rv;
         this->t = t;
@@ -310,15 +310,15 @@ namespace LB {
         os << lv << " <- length " << rv << " " << t;
     }
 
-    Instruction *AssignLengthInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        return new AssignLengthInst(getNewVar(scope, lv, varMap), getNewVar(scope, rv, varMap), getNewVar(scope, t, varMap));
+    Instruction *AssignLengthInst::getInstWithNewVar(VarMap &varMap) {
+        return new AssignLengthInst(getNewVar(lv, varMap), getNewVar(rv, varMap), getNewVar(t, varMap));
     }
 
     vector<LA::Instruction *> AssignLengthInst::getLA() {
         return {new LA::AssignLengthInst(lv, rv, t)};
     }
 
-    AssignCallInst::AssignCallInst(const string &v, const string &c, const vector <string> &as) {
+    AssignCallInst::AssignCallInst(const symbol::Symbol &v, const symbol::Symbol &c, const vector<symbol::Symbol> &as) {
         var = v;
         callee = c;
         args = as;
@@ -338,19 +338,19 @@ namespace LB {
         os << ")";
     }
 
-    Instruction *AssignCallInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        vector<string> nArgs;
+    Instruction *AssignCallInst::getInstWithNewVar(VarMap &varMap) {
+        vector<symbol::Symbol> nArgs;
         for (auto const &v : args) {
-            nArgs.push_back(getNewVar(scope, v, varMap));
+            nArgs.push_back(getNewVar(v, varMap));
         }
-        return new AssignCallInst(getNewVar(scope, var, varMap), getNewVar(scope, callee, varMap), nArgs);
+        return new AssignCallInst(getNewVar(var, varMap), getNewVar(callee, varMap), nArgs);
     }
 
     vector<LA::Instruction *> AssignCallInst::getLA() {
         return {new LA::AssignCallInst(var, callee, args)};
     }
 
-    NewArrayInst::NewArrayInst(const string &v, const vector <string> as) {
+    NewArrayInst::NewArrayInst(const symbol::Symbol &v, const vector<symbol::Symbol> &as) {
         var = v;
         args = as;
     }
@@ -366,19 +366,19 @@ namespace LB {
         os << ")";
     }
 
-    Instruction *NewArrayInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        vector<string> nArgs;
+    Instruction *NewArrayInst::getInstWithNewVar(VarMap &varMap) {
+        vector<symbol::Symbol> nArgs;
         for (auto const &v : args) {
-            nArgs.push_back(getNewVar(scope, v, varMap));
+            nArgs.push_back(getNewVar(v, varMap));
         }
-        return new NewArrayInst(getNewVar(scope, var, varMap), nArgs);
+        return new NewArrayInst(getNewVar(var, varMap), nArgs);
     }
 
     vector<LA::Instruction *> NewArrayInst::getLA() {
         return {new LA::NewArrayInst(var, args)};
     }
 
-    NewTupleInst::NewTupleInst(const string &v, const string &t) {
+    NewTupleInst::NewTupleInst(const symbol::Symbol &v, const symbol::Symbol &t) {
         var = v;
         this->t = t;
     }
@@ -387,25 +387,19 @@ namespace LB {
         os << var << " <- new Tuple(" << t << ")";
     }
 
-    Instruction *NewTupleInst::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
-        return new NewTupleInst(getNewVar(scope, var, varMap), getNewVar(scope, t, varMap));
+    Instruction *NewTupleInst::getInstWithNewVar(VarMap &varMap) {
+        return new NewTupleInst(getNewVar(var, varMap), getNewVar(t, varMap));
     }
 
     vector<LA::Instruction *> NewTupleInst::getLA() {
         return {new LA::NewTupleInst(var, t)};
     }
 
-    Scope::~Scope() {
-        for (auto const &inst : instructions) {
-            delete inst;
-        }
-    }
-
     void Scope::print(ostream &os) {
         throw runtime_error("scope print is not implemented");
     }
 
-    Instruction *Scope::getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) {
+    Instruction *Scope::getInstWithNewVar(VarMap &varMap) {
         throw runtime_error("getInstWithNewVar is not implemented in Scope");
     }
 
@@ -413,35 +407,29 @@ namespace LB {
         throw runtime_error("Scope::getLA() not implemented");
     }
 
-    Function::~Function() {
-        delete scope;
-    }
-
-    LA::Function *Function::getLA() {
-        map<Instruction *, string> whileToBegin, whileToEnd, WhileToCond;
-        map<string, Instruction *> beginToWhile, EndToWhile;
+    LA::Function *Function::getLA(VarMap &varMap, LoopMap &beginToWhile, LoopMap &endToWhile) {
+        map<Instruction *, symbol::Symbol> whileToEnd, whileToCond;
         LA::Function *f = new LA::Function();
         f->name = name;
         f->returnType = LA::Type(returnType.toString());
 
         vector<Instruction *> insts;
-        map<Scope *, map<string, string>> varMap;
-        map<string, string> m;
-        varMap[NULL] = m;
+        varMap.clear();
+        beginToWhile.clear();
+        endToWhile.clear();
         for (auto const &arg : arguments) {
-            varMap[NULL][arg.second] = arg.second;
+            varMap[arg.second].push_back(arg.second);
             f->arguments.push_back(new LA::TypeInst(arg.first.toString(), arg.second));
         }
         removeScope(scope, "", varMap, insts);
 
         for (int i = 0; i < insts.size(); i++) {
             if (WhileInst *whileInst = dynamic_cast<WhileInst *>(insts[i])) {
-                string condLabel = getAnotherLabel();
-                whileToBegin[whileInst] = whileInst->lb;
+                symbol::Symbol condLabel = getAnotherLabel();
                 whileToEnd[whileInst] = whileInst->rb;
-                WhileToCond[whileInst] = condLabel;
+                whileToCond[whileInst] = condLabel;
                 beginToWhile[whileInst->lb] = whileInst;
-                EndToWhile[whileInst->rb] = whileInst;
+                endToWhile[whileInst->rb] = whileInst;
                 insts.insert(insts.begin() + i, new LabelInst(condLabel));
                 i++;
             }
@@ -458,7 +446,7 @@ namespace LB {
             } else if (LabelInst *labelInst = dynamic_cast<LabelInst *>(inst)) {
                 if (beginToWhile.count(labelInst->lb) > 0 && (loopStack.empty() || loopStack.top() != beginToWhile.at(labelInst->lb))) {
                     loopStack.push(beginToWhile.at(labelInst->lb));
-                } else if (EndToWhile.count(labelInst->lb) > 0) {
+                } else if (endToWhile.count(labelInst->lb) > 0) {
                     loopStack.pop();
                 }
                 las = labelInst->getLA();
@@ -471,7 +459,7 @@ namespace LB {
                 las.push_back(new LA::AssignOpInst(flag, whileInst->lt, whileInst->rt, opToString(whileInst->op)));
                 las.push_back(new LA::BranchInst(flag, whileInst->lb, whileInst->rb));
             } else if (ContinueInst *continueInst = dynamic_cast<ContinueInst *>(inst)) {
-                las.push_back(new LA::BranchInst(WhileToCond[loopStack.top()]));
+                las.push_back(new LA::BranchInst(whileToCond[loopStack.top()]));
             } else if (BreakInst *breakInst = dynamic_cast<BreakInst *>(inst)) {
                 las.push_back(new LA::BranchInst(whileToEnd[loopStack.top()]));
             } else if (Scope *scope = dynamic_cast<Scope *>(inst)) {
@@ -488,17 +476,13 @@ namespace LB {
         return f;
     }
 
-    Program::~Program() {
-        for (auto const &f : functions) {
-            delete f;
-        }
-    }
-
     LA::Program Program::getLA() {
         LA::Program p;
+        VarMap varMap;
+        LoopMap beginToWhile, endToWhile;
         p.name = name;
         for (auto const &f : functions) {
-            p.functions.push_back(f->getLA());
+            p.functions.push_back(f->getLA(varMap, beginToWhile, endToWhile));
         }
         return p;
     }
@@ -6,6 +6,8 @@
 #include <set>
 #include <map>
 #include <utility>
+#include <arena.h>
+#include <symbol.h>
 
 #include "la.h"
 
@@ -78,12 +80,18 @@ namespace LB {
         string toString() const;
     };
 
-    struct Instruction {
+    /*
+     * New names of the variables in scope, by symbol id. A declaration pushes the new name
+     * of its variable and leaving the scope pops it again, so the innermost one is last.
+     * */
+    typedef symbol::Table<vector<symbol::Symbol>> VarMap;
+
+    struct Instruction : arena::Node {
         virtual ~Instruction() {};
 
         virtual void print(ostream &os) = 0;
 
-        virtual Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap) = 0;
+        virtual Instruction *getInstWithNewVar(VarMap &varMap) = 0;
 
         virtual vector<LA::Instruction *> getLA() = 0;
     };
@@ -92,107 +100,107 @@ namespace LB {
 
     struct TypeInst : Instruction {
         Type type;
-        vector<string> vars;
+        vector<symbol::Symbol> vars;
 
-        TypeInst(const string &t, const vector<string> &vars);
+        TypeInst(const symbol::Symbol &t, const vector<symbol::Symbol> &vars);
 
         ~TypeInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct AssignInst : Instruction {
-        string var, s;
-        vector <string> varIndex, sIndex;
+        symbol::Symbol var, s;
+        vector<symbol::Symbol> varIndex, sIndex;
 
-        AssignInst(const string &v, const string &s);
+        AssignInst(const symbol::Symbol &v, const symbol::Symbol &s);
 
-        AssignInst(const string &lv, const string &rv, const vector <string> &ts);
+        AssignInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const vector<symbol::Symbol> &ts);
 
-        AssignInst(const string &v, const vector <string> &ts, const string &s);
+        AssignInst(const symbol::Symbol &v, const vector<symbol::Symbol> &ts, const symbol::Symbol &s);
 
         ~AssignInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct AssignCondInst : Instruction {
-        string var, lt, rt;
+        symbol::Symbol var, lt, rt;
         OP op;
 
-        AssignCondInst(const string &var, const string &lt, const string &op, const string &rt);
+        AssignCondInst(const symbol::Symbol &var, const symbol::Symbol &lt, const symbol::Symbol &op, const symbol::Symbol &rt);
 
         ~AssignCondInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct LabelInst : Instruction {
-        string lb;
+        symbol::Symbol lb;
 
-        LabelInst(const string &s);
+        LabelInst(const symbol::Symbol &s);
 
         ~LabelInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct IfInst : Instruction {
-        string lt, rt, lb, rb;
+        symbol::Symbol lt, rt, lb, rb;
         OP op;
 
-        IfInst(const string &lt, const string &op, const string &rt, const string &lb, const string &rb);
+        IfInst(const symbol::Symbol &lt, const symbol::Symbol &op, const symbol::Symbol &rt, const symbol::Symbol &lb, const symbol::Symbol &rb);
 
         ~IfInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct ReturnInst : Instruction {
-        string t;
+        symbol::Symbol t;
 
-        ReturnInst(const string &s);
+        ReturnInst(const symbol::Symbol &s);
 
         ~ReturnInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct WhileInst : Instruction {
-        string lt, rt, lb, rb;
+        symbol::Symbol lt, rt, lb, rb;
         OP op;
 
-        WhileInst(const string &lt, const string &op, const string &rt, const string &lb, const string &rb);
+        WhileInst(const symbol::Symbol &lt, const symbol::Symbol &op, const symbol::Symbol &rt, const symbol::Symbol &lb, const symbol::Symbol &rb);
 
         ~WhileInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
@@ -202,7 +210,7 @@ namespace LB {
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
@@ -212,65 +220,65 @@ namespace LB {
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct AssignLengthInst : Instruction {
-        string lv, rv, t;
+        symbol::Symbol lv, rv, t;
 
-        AssignLengthInst(const string &lv, const string &rv, const string &t);
+        AssignLengthInst(const symbol::Symbol &lv, const symbol::Symbol &rv, const symbol::Symbol &t);
 
         ~AssignLengthInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct AssignCallInst : Instruction {
-        string var, callee;
-        vector <string> args;
+        symbol::Symbol var, callee;
+        vector<symbol::Symbol> args;
 
-        AssignCallInst(const string &v, const string &c, const vector <string> &as);
+        AssignCallInst(const symbol::Symbol &v, const symbol::Symbol &c, const vector<symbol::Symbol> &as);
 
         ~AssignCallInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct NewArrayInst : Instruction {
-        string var;
-        vector <string> args;
+        symbol::Symbol var;
+        vector<symbol::Symbol> args;
 
-        NewArrayInst(const string &v, const vector <string> as);
+        NewArrayInst(const symbol::Symbol &v, const vector<symbol::Symbol> &as);
 
         ~NewArrayInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
     struct NewTupleInst : Instruction {
-        string var, t;
+        symbol::Symbol var, t;
 
-        NewTupleInst(const string &v, const string &t);
+        NewTupleInst(const symbol::Symbol &v, const symbol::Symbol &t);
 
         ~NewTupleInst() {};
 
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
@@ -279,32 +287,31 @@ namespace LB {
         vector<Instruction *> instructions;
         Scope *parent;
 
-        ~Scope();
-
         void print(ostream &os);
 
-        Instruction *getInstWithNewVar(Scope *scope, map<Scope *, map<string, string>> &varMap);
+        Instruction *getInstWithNewVar(VarMap &varMap);
 
         vector<LA::Instruction *> getLA();
     };
 
-    struct Function {
-        string name;
+    /*
+     * The while loop that a label begins or ends, by symbol id.
+     * */
+    typedef symbol::Table<Instruction *> LoopMap;
+
+    struct Function : arena::Node {
+        symbol::Symbol name;
         Type returnType;
-        vector<pair<Type, string>> arguments;
+        vector<pair<Type, symbol::Symbol>> arguments;
         Scope *scope;
 
-        ~Function();
-
-        LA::Function *getLA();
+        LA::Function *getLA(VarMap &varMap, LoopMap &beginToWhile, LoopMap &endToWhile);
     };
 
     struct Program {
-        string name;
+        symbol::Symbol name;
         vector<Function *> functions;
 
-        ~Program();
-
         LA::Program getLA();
     };
 }
@@ -106,7 +106,7 @@ namespace LB {
     struct p : seq<wSeps, f, star<seq<sSeps, f>>, wSeps> {};
 
 
-    vector<std::string> operands;
+    vector<symbol::Symbol> operands;
     Scope *funcScope = NULL;
 
 
@@ -116,63 +116,63 @@ namespace LB {
     template<>
     struct action<T> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<type> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<callee> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<s> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<t> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<op> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<name> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<label> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
     template<>
     struct action<var> {
         static void apply(const input &in, Program &p) {
-            operands.push_back(in.string());
+            operands.push_back(symbol::Symbol(in.begin(), in.size()));
         }
     };
 
@@ -235,7 +235,7 @@ namespace LB {
     struct action<typeInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 2);
-            std::string type = operands[0];
+            symbol::Symbol type = operands[0];
             operands.erase(operands.begin());
             funcScope->instructions.push_back(new TypeInst(type, operands));
             operands.clear();
@@ -263,7 +263,7 @@ namespace LB {
     template<>
     struct action<labelInst> {
         static void apply(const input &in, Program &p) {
-            funcScope->instructions.push_back(new LabelInst(in.string()));
+            funcScope->instructions.push_back(new LabelInst(symbol::Symbol(in.begin(), in.size())));
             operands.clear();
         }
     };
@@ -317,7 +317,7 @@ namespace LB {
     struct action<arrayToVarInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 7);
-            std::string lv = operands[4], rv = operands[5];
+            symbol::Symbol lv = operands[4], rv = operands[5];
             operands.erase(operands.begin(), operands.begin() + 6);
             funcScope->instructions.push_back(new AssignInst(lv, rv, operands));
             operands.clear();
@@ -328,7 +328,7 @@ namespace LB {
     struct action<varToArrayInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 8);
-            std::string var = operands[5], s = operands.back();
+            symbol::Symbol var = operands[5], s = operands.back();
             operands.erase(operands.begin(), operands.begin() + 6);
             operands.pop_back();
             funcScope->instructions.push_back(new AssignInst(var, operands, s));
@@ -350,7 +350,7 @@ namespace LB {
     struct action<callInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 1);
-            std::string callee = operands[0];
+            symbol::Symbol callee = operands[0];
             operands.erase(operands.begin());
             funcScope->instructions.push_back(new AssignCallInst("", callee, operands));
             operands.clear();
@@ -361,7 +361,7 @@ namespace LB {
     struct action<assignCallInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 4);
-            std::string var = operands[2], callee = operands[3];
+            symbol::Symbol var = operands[2], callee = operands[3];
             operands.erase(operands.begin(), operands.begin() + 4);
             funcScope->instructions.push_back(new AssignCallInst(var, callee, operands));
             operands.clear();
@@ -372,7 +372,7 @@ namespace LB {
     struct action<newArrayInst> {
         static void apply(const input &in, Program &p) {
             assert(operands.size() >= 3);
-            std::string var = operands[1];
+            symbol::Symbol var = operands[1];
             operands.erase(operands.begin(), operands.begin() + 2);
             funcScope->instructions.push_back(new NewArrayInst(var, operands));
             operands.clear();
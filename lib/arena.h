@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <mutex>
+#include <new>
+#include <iostream>
+#include <sys/resource.h>
+
+namespace arena {
+    /*
+     * Bump allocator owning the IR nodes of one compilation. Deleting a node only runs its
+     * destructor, nothing is freed before the process exits. Every compiler runs one stage
+     * per process, so the arena lives as long as the stage and there is no reset.
+     * */
+    class Arena {
+    public:
+        ~Arena() {
+            for (auto block : blocks) {
+                std::free(block);
+            }
+        }
+
+        void *allocate(size_t size) {
+            size = (size + 15) & ~(size_t)15;
+            std::lock_guard<std::mutex> lock(m);
+            if (used + size > capacity) {
+                capacity = size > block_size ? size : block_size;
+                char *block = (char *)std::malloc(capacity);
+                if (block == NULL) {
+                    throw std::bad_alloc();
+                }
+                blocks.push_back(block);
+                current = block;
+                used = 0;
+                reserved += capacity;
+            }
+            void *p = current + used;
+            used += size;
+            allocations++;
+            bytes += size;
+            return p;
+        }
+
+        size_t allocations = 0, bytes = 0, reserved = 0;
+
+    private:
+        static const size_t block_size = 1 << 20;
+        std::vector<char *> blocks;
+        char *current = NULL;
+        size_t used = 0, capacity = 0;
+        std::mutex m;
+    };
+
+    inline Arena &nodes() {
+        static Arena arena;
+        return arena;
+    }
+
+    /*
+     * Base of every node type, so a plain new takes the node from the arena.
+     * */
+    struct Node {
+        static void *operator new(size_t size) {
+            return nodes().allocate(size);
+        }
+
+        static void operator delete(void *) {
+        }
+    };
+
+    /*
+     * With COMPILER_STATS=1, prints the node count, the arena size and the peak RSS of this
+     * compilation to stderr.
+     * */
+    inline void report(const char *stage) {
+        const char *stats = std::getenv("COMPILER_STATS");
+        if (stats == NULL || std::strcmp(stats, "1") != 0) {
+            return;
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        std::cerr << stage << ": " << nodes().allocations << " nodes, " << nodes().bytes << " bytes in "
+                  << nodes().reserved / 1024 << " KB of arena, peak RSS " << usage.ru_maxrss << " KB" << std::endl;
+    }
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+
+namespace symbol {
+    /*
+     * Program-wide table of interned names. Every name is stored once and stands for a
+     * 32-bit id from then on. Names live in fixed chunks that never move, so reading a name
+     * needs no lock, only interning a new one does.
+     * */
+    class Interner {
+    public:
+        Interner() {
+            intern("", 0);
+        }
+
+        uint32_t intern(const char *begin, size_t size) {
+            std::lock_guard<std::mutex> lock(m);
+            auto it = ids.find(Key{begin, size});
+            if (it != ids.end()) {
+                return it->second;
+            }
+            uint32_t id = count;
+            if (id % chunk_size == 0) {
+                chunks[id / chunk_size] = new std::string[chunk_size];
+            }
+            std::string &name = chunks[id / chunk_size][id % chunk_size];
+            name.assign(begin, size);
+            ids.emplace(Key{name.data(), size}, id);
+            count++;
+            return id;
+        }
+
+        inline const std::string &name(uint32_t id) const {
+            return chunks[id / chunk_size][id % chunk_size];
+        }
+
+        uint32_t size() {
+            std::lock_guard<std::mutex> lock(m);
+            return count;
+        }
+
+    private:
+        /*
+         * The ids are keyed by the characters of the stored names, which never move, so
+         * looking a name up needs no copy of it.
+         * */
+        struct Key {
+            const char *begin;
+            size_t size;
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key &k) const {
+                size_t h = 14695981039346656037ULL;
+                for (size_t i = 0; i < k.size; i++) {
+                    h = (h ^ (unsigned char)k.begin[i]) * 1099511628211ULL;
+                }
+                return h;
+            }
+        };
+
+        struct KeyEqual {
+            bool operator()(const Key &a, const Key &b) const {
+                return a.size == b.size && std::memcmp(a.begin, b.begin, a.size) == 0;
+            }
+        };
+
+        static const uint32_t chunk_size = 1 << 12;
+        std::string *chunks[1 << 16] = {};
+        uint32_t count = 0;
+        std::unordered_map<Key, uint32_t, KeyHash, KeyEqual> ids;
+        std::mutex m;
+    };
+
+    inline Interner &interner() {
+        static Interner *table = new Interner;
+        return *table;
+    }
+
+    /*
+     * An interned name. It converts to the string it stands for, equality is a compare of
+     * ids, and ordering is by name so containers keep the order they had with strings.
+     * */
+    class Symbol {
+    public:
+        /*
+         * The empty name, which the interner always holds as id 0.
+         * */
+        Symbol() : symbol_id(0) {
+        }
+
+        Symbol(const std::string &s) : symbol_id(interner().intern(s.data(), s.size())) {
+        }
+
+        Symbol(const char *s) : symbol_id(interner().intern(s, std::strlen(s))) {
+        }
+
+        Symbol(const char *begin, size_t size) : symbol_id(interner().intern(begin, size)) {
+        }
+
+        inline uint32_t id() const {
+            return symbol_id;
+        }
+
+        inline const std::string &str() const {
+            return interner().name(symbol_id);
+        }
+
+        inline operator const std::string &() const {
+            return str();
+        }
+
+        inline char operator[](size_t i) const {
+            return str()[i];
+        }
+
+        inline size_t size() const {
+            return str().size();
+        }
+
+        inline size_t length() const {
+            return str().size();
+        }
+
+        inline bool empty() const {
+            return str().empty();
+        }
+
+        inline std::string substr(size_t pos, size_t n = std::string::npos) const {
+            return str().substr(pos, n);
+        }
+
+        inline size_t find(const std::string &s, size_t pos = 0) const {
+            return str().find(s, pos);
+        }
+
+        inline bool operator==(const Symbol &o) const {
+            return symbol_id == o.symbol_id;
+        }
+
+        inline bool operator!=(const Symbol &o) const {
+            return symbol_id != o.symbol_id;
+        }
+
+        inline bool operator<(const Symbol &o) const {
+            return symbol_id != o.symbol_id && str() < o.str();
+        }
+
+    private:
+        uint32_t symbol_id;
+    };
+
+    inline bool operator==(const Symbol &a, const std::string &b) {
+        return a.str() == b;
+    }
+
+    inline bool operator==(const std::string &a, const Symbol &b) {
+        return a == b.str();
+    }
+
+    inline bool operator==(const Symbol &a, const char *b) {
+        return a.str() == b;
+    }
+
+    inline bool operator!=(const Symbol &a, const std::string &b) {
+        return a.str() != b;
+    }
+
+    inline bool operator!=(const std::string &a, const Symbol &b) {
+        return a != b.str();
+    }
+
+    inline bool operator!=(const Symbol &a, const char *b) {
+        return a.str() != b;
+    }
+
+    inline std::string operator+(const Symbol &a, const std::string &b) {
+        return a.str() + b;
+    }
+
+    inline std::string operator+(const std::string &a, const Symbol &b) {
+        return a + b.str();
+    }
+
+    inline std::string operator+(const Symbol &a, const char *b) {
+        return a.str() + b;
+    }
+
+    inline std::string operator+(const char *a, const Symbol &b) {
+        return a + b.str();
+    }
+
+    inline std::string operator+(const Symbol &a, char b) {
+        return a.str() + b;
+    }
+
+    inline std::string operator+(char a, const Symbol &b) {
+        return a + b.str();
+    }
+
+    inline std::ostream &operator<<(std::ostream &os, const Symbol &s) {
+        return os << s.str();
+    }
+
+    /*
+     * Map from symbols to values, stored flat by symbol id. keys lists the symbols in the
+     * order they were added, and clear only resets those, so one table can serve every
+     * function of a program without growing back from nothing each time.
+     * */
+    template<typename T>
+    class Table {
+    public:
+        T &operator[](const Symbol &s) {
+            uint32_t id = s.id();
+            if (id >= present.size()) {
+                present.resize(id + 1, false);
+                values.resize(id + 1);
+            }
+            if (!present[id]) {
+                present[id] = true;
+                added.push_back(s);
+            }
+            return values[id];
+        }
+
+        size_t count(const Symbol &s) const {
+            return s.id() < present.size() && present[s.id()] ? 1 : 0;
+        }
+
+        const T &at(const Symbol &s) const {
+            if (count(s) == 0) {
+                throw std::out_of_range("no entry for " + s.str());
+            }
+            return values[s.id()];
+        }
+
+        T &at(const Symbol &s) {
+            if (count(s) == 0) {
+                throw std::out_of_range("no entry for " + s.str());
+            }
+            return values[s.id()];
+        }
+
+        const std::vector<Symbol> &keys() const {
+            return added;
+        }
+
+        void clear() {
+            for (auto const &s : added) {
+                present[s.id()] = false;
+                values[s.id()] = T();
+            }
+            added.clear();
+        }
+
+    private:
+        std::vector<T> values;
+        std::vector<bool> present;
+        std::vector<Symbol> added;
+    };
+
+    /*
+     * Set of symbols kept the same way as a Table.
+     * */
+    class Set {
+    public:
+        bool insert(const Symbol &s) {
+            uint32_t id = s.id();
+            if (id >= present.size()) {
+                present.resize(id + 1, false);
+            }
+            if (present[id]) {
+                return false;
+            }
+            present[id] = true;
+            added.push_back(s);
+            return true;
+        }
+
+        size_t count(const Symbol &s) const {
+            return s.id() < present.size() && present[s.id()] ? 1 : 0;
+        }
+
+        const std::vector<Symbol> &keys() const {
+            return added;
+        }
+
+        void clear() {
+            for (auto const &s : added) {
+                present[s.id()] = false;
+            }
+            added.clear();
+        }
+
+    private:
+        std::vector<bool> present;
+        std::vector<Symbol> added;
+    };
+}